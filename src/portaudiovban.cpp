@@ -48,14 +48,14 @@ namespace nap
         }
 
 
-        void PortAudioVBANServer::threadFunction()
+        void PortAudioVBANServer::threadFunction(int shard)
         {
             auto threadWorkgroup = mWorkGroup;
             os_workgroup_join_token_s joinToken;
             auto result = os_workgroup_join(threadWorkgroup, &joinToken);
             assert(result == 0);
 
-            workLoop();
+            workLoop(shard);
 
             os_workgroup_leave(threadWorkgroup, &joinToken);
             assert(result == 0);
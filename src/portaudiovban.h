@@ -33,7 +33,7 @@ namespace nap
             void stop() override;
 
         protected:
-            void threadFunction() override;
+            void threadFunction(int shard) override;
 
         private:
             Slot<const audio::PortAudioServiceConfiguration::DeviceSettings&> mDeviceSettingsChangedSlot = { this, &PortAudioVBANServer::deviceSettingsChanged };
@@ -0,0 +1,137 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace nap
+{
+
+	/**
+	 * Fixed capacity lock-free queue for any number of producer and consumer threads.
+	 * All memory is allocated on construction, pushing and popping never allocate, lock or wait for other threads,
+	 * so any thread can use the queue without setting up per-thread state first.
+	 * Every cell carries a sequence number that tells producers and consumers whose turn it is, after D. Vyukov's bounded MPMC queue.
+	 */
+	template<typename T>
+	class VBANBoundedQueue final
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Elements are copied in and out of the cells");
+
+	public:
+		/**
+		 * @param capacity Minimum number of elements the queue holds, rounded up to a power of two
+		 */
+		explicit VBANBoundedQueue(int capacity)
+		{
+			size_t size = 2;
+			while (size < static_cast<size_t>(capacity))
+				size <<= 1;
+			mCells = std::make_unique<Cell[]>(size);
+			mMask = size - 1;
+			for (size_t i = 0; i < size; ++i)
+				mCells[i].mSequence.store(i, std::memory_order_relaxed);
+		}
+
+		VBANBoundedQueue(const VBANBoundedQueue&) = delete;
+		VBANBoundedQueue& operator=(const VBANBoundedQueue&) = delete;
+
+		/**
+		 * Adds an element to the back of the queue. Thread-Safe
+		 * @param value The element
+		 * @return False when the queue is full, the element is not added.
+		 */
+		bool tryPush(const T& value)
+		{
+			size_t position = mTail.load(std::memory_order_relaxed);
+			while (true)
+			{
+				auto& cell = mCells[position & mMask];
+				const size_t sequence = cell.mSequence.load(std::memory_order_acquire);
+				const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+				if (difference == 0)
+				{
+					if (mTail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						cell.mValue = value;
+						cell.mSequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0)
+				{
+					return false;
+				}
+				else {
+					position = mTail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/**
+		 * Removes the element at the front of the queue. Thread-Safe
+		 * @param value Receives the element
+		 * @return False when the queue is empty.
+		 */
+		bool tryPop(T& value)
+		{
+			size_t position = mHead.load(std::memory_order_relaxed);
+			while (true)
+			{
+				auto& cell = mCells[position & mMask];
+				const size_t sequence = cell.mSequence.load(std::memory_order_acquire);
+				const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+				if (difference == 0)
+				{
+					if (mHead.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						value = cell.mValue;
+						cell.mSequence.store(position + mMask + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0)
+				{
+					return false;
+				}
+				else {
+					position = mHead.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/**
+		 * @return The number of elements the queue holds.
+		 */
+		int getCapacity() const { return static_cast<int>(mMask + 1); }
+
+		/**
+		 * @return The number of elements in the queue, only an estimate while other threads push or pop.
+		 */
+		int getSizeApprox() const
+		{
+			const size_t tail = mTail.load(std::memory_order_relaxed);
+			const size_t head = mHead.load(std::memory_order_relaxed);
+			return tail > head ? static_cast<int>(tail - head) : 0;
+		}
+
+	private:
+		struct Cell
+		{
+			std::atomic<size_t> mSequence = { 0 };
+			T mValue = { };
+		};
+
+		std::unique_ptr<Cell[]> mCells;
+		size_t mMask = 0;
+		alignas(64) std::atomic<size_t> mTail = { 0 };		// Position of the next push, producers don't share a cache line with consumers
+		alignas(64) std::atomic<size_t> mHead = { 0 };		// Position of the next pop
+	};
+
+}
@@ -3,26 +3,137 @@
 #include <audio/core/audionodemanager.h>
 #include <nap/logger.h>
 #include <vbanutils.h>
+#include <vbandecode.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
 
 namespace nap
 {
 
-	VBANCircularBuffer::VBANCircularBuffer(audio::NodeManager &nodeManager, int size) : audio::Process(nodeManager), mSize(size)
+	/**
+	 * Scoped writer lock of a stream. Every stream is received by a single shard of a server,
+	 * only the shards of a redundant server and receivers sharing a stream contend, for as long as the other thread converts a packet.
+	 * A writer that finds the stream busy spins briefly and then yields, so a realtime thread of equal priority holding the lock on the same core gets to finish.
+	 */
+	class StreamWriteLock
+	{
+	public:
+		StreamWriteLock(std::atomic<bool>& writing) : mWriting(writing)
+		{
+			if (!mWriting.exchange(true, std::memory_order_acquire))
+				return;
+
+			mContended = true;
+			for (auto spin = 0; mWriting.load(std::memory_order_relaxed) || mWriting.exchange(true, std::memory_order_acquire); ++spin)
+			{
+				if (spin >= sSpinCount)
+					std::this_thread::yield();
+			}
+		}
+
+		~StreamWriteLock() { mWriting.store(false, std::memory_order_release); }
+
+		bool wasContended() const { return mContended; }
+
+	private:
+		static constexpr int sSpinCount = 256;	// Attempts before yielding, converting a packet takes a few microseconds
+
+		std::atomic<bool>& mWriting;
+		bool mContended = false;
+	};
+
+
+	// Converts little endian samples of the given VBAN bit resolution to floats
+	static void convertSamples(uint8_t bitFormat, const uint8_t* source, int sampleCount, float* destination)
 	{
-		mStreamName.reserve(VBAN_STREAM_NAME_SIZE);
+		switch (bitFormat)
+		{
+		case VBAN_BITFMT_32_FLOAT:
+			utility::convertVBANFloat32(source, sampleCount, destination);
+			break;
+		case VBAN_BITFMT_32_INT:
+			utility::convertVBANInt32(source, sampleCount, destination);
+			break;
+		case VBAN_BITFMT_24_INT:
+			utility::convertVBANInt24(source, sampleCount, destination);
+			break;
+		default:
+			utility::convertVBANInt16(source, sampleCount, destination);
+			break;
+		}
 	}
 
 
-	bool VBANCircularBuffer::write(const VBanHeader& header, size_t size)
+	// Tag of a packet slot that holds no valid packet
+	static constexpr uint32_t sInvalidTag = std::numeric_limits<uint32_t>::max();
+
+
+	VBANCircularBuffer::StreamData::StreamData(int channelCount, int size, EVBANBufferLayout layout) : mChannelCount(channelCount), mSize(size)
 	{
-		std::lock_guard<std::mutex> lock(mBufferMapMutex);
+		// Enough slots for packets of a single frame
+		mTags = std::make_unique<std::atomic<uint32_t>[]>(size);
+		invalidateTags();
 
-		// Find stream buffer
-		mStreamName = header.streamname;
-		auto it = mBufferMap.find(mStreamName);
-		if (it == mBufferMap.end())	// Exit quietly when stream is not found
+		if (layout == EVBANBufferLayout::Planar)
+		{
+			mPlanes.resize(channelCount, size);
+			return;
+		}
+
+		// Align the first frame to a cache line, so frames never share a cache line with other data
+		constexpr size_t alignment = 64 / sizeof(float);
+		mStorage.resize(static_cast<size_t>(channelCount) * size + alignment, 0.f);
+		const auto misalignment = reinterpret_cast<uintptr_t>(mStorage.data()) % 64 / sizeof(float);
+		mFrames = mStorage.data() + (misalignment == 0 ? 0 : alignment - misalignment);
+	}
+
+
+	void VBANCircularBuffer::StreamData::invalidateTags()
+	{
+		for (auto i = 0; i < mSize; ++i)
+			mTags[i].store(sInvalidTag, std::memory_order_relaxed);
+	}
+
+
+	VBANCircularBuffer::VBANCircularBuffer(audio::NodeManager &nodeManager, int size, int maxStreamCount, EVBANBufferLayout layout) : audio::Process(nodeManager),
+		mRegistry(std::make_unique<StreamRegistry>(maxStreamCount)), mLayout(layout)
+	{
+		// Every stream can have a timeline of its own
+		mTimelines = std::make_unique<Timeline[]>(std::max(maxStreamCount, 1));
+
+		mSize = 1;
+		while (mSize < size)
+			mSize <<= 1;
+		mMask = mSize - 1;
+	}
+
+
+	bool VBANCircularBuffer::write(const VBANPacket& packet, int path)
+	{
+		assert(path >= 0 && path < sMaxPathCount);
+		const auto& header = packet.getHeader();
+		const auto size = packet.size();
+
+		// The registry is read without locking, the control thread can't release the stream while the section is held
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+
+		// Find stream buffer by name and sender, the stream name is not necessarily null terminated
+		const VBANStreamKey key(header.streamname, packet.getSource());
+		auto* slot = findStream(*registry, key);
+		if (slot == nullptr)	// Exit quietly when stream is not found
 			return false;
-		auto& streamBuffer = it->second;
+		auto* streamBuffer = slot->mStream.get();
+		auto& streamData = *slot->mData;
+		auto& timeline = mTimelines[slot->mTimeline];
+		// A copy of the packet the other path wrote meanwhile is recognized as a duplicate below
+		StreamWriteLock stream_lock(streamBuffer->mWriting);
+		if (stream_lock.wasContended())
+			mWriteContentionCount++;
 
 		// Check packet integrity
 		if (!checkPacket(header, size))
@@ -30,12 +141,14 @@ namespace nap
 
 		// Check supported bit depth and derive sample size
 		int sample_size = 0;
-		if (header.format_bit == VBAN_BITFMT_32_INT)
+		if (header.format_bit == VBAN_BITFMT_32_INT || header.format_bit == VBAN_BITFMT_32_FLOAT)
 			sample_size = 4;
+		else if (header.format_bit == VBAN_BITFMT_24_INT)
+			sample_size = 3;
 		else if (header.format_bit == VBAN_BITFMT_16_INT)
 			sample_size = 2;
 		else {
-			setError("Unsupported bit depth.");
+			setError(EVBANEvent::UnsupportedBitDepth, header.format_bit, key.mName.data());
 			return false;
 		}
 
@@ -44,168 +157,525 @@ namespace nap
 		int packet_sample_rate = 0;
 		if (!utility::getSampleRateFromVBANSampleRateFormat(packet_sample_rate, sample_rate_format))
 		{
-			setError("Unsupported sample rate.");
+			setError(EVBANEvent::UnsupportedSampleRate, sample_rate_format, key.mName.data());
 			return false;
 		}
-		if (packet_sample_rate != getSampleRate())
+		// Streams at another sample rate are converted when read, the lowest of their rates determines how far interpolation reads ahead
+		const int engine_sample_rate = static_cast<int>(getSampleRate());
+		if (packet_sample_rate != engine_sample_rate)
 		{
-			setError("Sample rate mismatch.");
-			return false;
+			auto lowest_sample_rate = timeline.mLowestSampleRate.load();
+			while ((lowest_sample_rate == 0 || packet_sample_rate < lowest_sample_rate) && !timeline.mLowestSampleRate.compare_exchange_weak(lowest_sample_rate, packet_sample_rate));
 		}
 
 		const int frameCount = header.format_nbs + 1;
 		const int channelCount = header.format_nbc + 1;
+		if (VBAN_HEADER_SIZE + frameCount * channelCount * sample_size > size)
+		{
+			setError(EVBANEvent::IncompletePacket, 0, key.mName.data());
+			return false;
+		}
 		const auto packetCounter = header.nuFrame;
 		const audio::DiscreteTimeValue time = packetCounter * frameCount;
 
-		if (packetCounter == 0)
-			streamBuffer->mPacketCounter.store(0);
-		if (packetCounter != streamBuffer->mPacketCounter.load())
-			nap::Logger::info("VBANCircularBuffer: Packet loss detected for stream %s", mStreamName.c_str());
-		streamBuffer->mPacketCounter.store(packetCounter + 1);
+		// Positions of the timeline are in frames of the engine
+		const auto to_engine_time = [&](audio::DiscreteTimeValue value) { return packet_sample_rate == engine_sample_rate ? value : value * engine_sample_rate / packet_sample_rate; };
+		const audio::DiscreteTimeValue engine_time = to_engine_time(time);
+
+		// Packets arrive in order over a single path, so the path tells a restarting sender by packet 0 following a higher packet counter.
+		// The restart only applies to the stream when the path carried the current sequence, otherwise another path restarted it already.
+		auto& path_statistics = streamBuffer->mPathStatistics[path];
+		auto& path_sequence = streamBuffer->mPathSequence[path];
+		const bool path_restart = path_statistics.isRestart(packetCounter);
+		const bool path_current = path_sequence == streamBuffer->mSequence;
+		const bool restart = path_restart && path_current;
+		if (restart)
+			path_sequence = ++streamBuffer->mSequence;
+
+		// Counted without logging, this thread has to keep up when packets are lost
+		path_statistics.addArrival(packetCounter, size, path_restart);
+
+		// Over redundant paths every packet arrives more than once, the copy that arrives first is kept and later copies are dropped.
+		// Recognized by the tag of the packet slot: a copy of the packet the slot holds is dropped, and so is a packet older than it unless it restarts the sequence.
+		const bool format_matches = streamData.getChannelCount() == channelCount && streamData.mPacketFrameCount.load(std::memory_order_relaxed) == frameCount &&
+			streamData.mSampleRate.load(std::memory_order_relaxed) == packet_sample_rate;
+		const uint32_t slot_tag = streamData.mTags[getTagSlot(packetCounter, frameCount)].load(std::memory_order_relaxed);
 
-		// Deinterleave and convert directly into circular buffer if channel count matches
-		if (streamBuffer->mData.getChannelCount() == channelCount)
+		// A path that still carries packets from before a restart over another path is dropped,
+		// until it delivers the first packet of the new sequence or a copy of a packet of the new sequence
+		if (!path_current)
 		{
-			auto pos = time % mSize;
-			const uint8_t* data = reinterpret_cast<const uint8_t*>(&header) + VBAN_HEADER_SIZE;
-			if (sample_size == 4) // 32 bit
+			if (packetCounter != 0 && !(format_matches && slot_tag == packetCounter))
+				return false;
+			path_sequence = streamBuffer->mSequence;
+		}
+
+		// Only packets of the current sequence are counted over all paths, a lagging path would move the sequence back
+		streamBuffer->mReceiveStatistics.addArrival(packetCounter, size, restart);
+
+		if (format_matches && slot_tag != sInvalidTag && (slot_tag == packetCounter || (!restart && static_cast<int32_t>(packetCounter - slot_tag) < 0)))
+			return true;
+
+		if (packet.getTimestamp() != 0)
+			streamBuffer->mJitterStatistics.addArrival(packet.getTimestamp(), packetCounter, frameCount, packet_sample_rate);
+
+		// Audio that the timeline read past arrived too late to be played and is dropped, a sender that restarts starts over ahead of the read position
+		if (!restart && to_engine_time(time + frameCount) <= timeline.mSharedReadPosition.load(std::memory_order_relaxed))
+		{
+			streamBuffer->mReceiveStatistics.addLateArrival();
+			return false;
+		}
+
+		// Write into the circular buffer if channel count matches, in at most two segments split where the circular buffer wraps
+		if (streamData.getChannelCount() == channelCount)
+		{
+			// Tags of a previous packet size, sample rate or of a sender that restarted would match the wrong packets
+			if (streamData.mPacketFrameCount.load(std::memory_order_relaxed) != frameCount || streamData.mSampleRate.load(std::memory_order_relaxed) != packet_sample_rate || restart)
 			{
-				for (int i = 0; i < frameCount; ++i)
-				{
-					for (int ch = 0; ch < channelCount; ++ch)
-					{
-						unsigned char b1 = data[0];
-						unsigned char b2 = data[1];
-						unsigned char b3 = data[2];
-						unsigned char b4 = data[3];
-						int32_t ival = (static_cast<int32_t>(b4) << 24) |
-										(static_cast<int32_t>(b3) << 16) |
-										(static_cast<int32_t>(b2) << 8)  |
-										(0x000000ff & b1);
-						float f = static_cast<float>(ival) / static_cast<float>(std::numeric_limits<int32_t>::max());
-						streamBuffer->mData[ch][pos] = f;
-						data += 4;
-					}
-					pos++;
-					if (pos >= mSize) pos = 0;
-				}
+				streamData.invalidateTags();
+				streamData.mSampleRate.store(packet_sample_rate, std::memory_order_release);
+				streamData.mPacketFrameCount.store(frameCount, std::memory_order_release);
 			}
-			else // 16-bit
+
+			// Invalidate the slot while the packet is written, and publish the packet once it is.
+			// The fence keeps the samples from being written before the slot is invalidated, readers check the tag again after copying.
+			auto& tag = streamData.mTags[getTagSlot(packetCounter, frameCount)];
+			tag.store(sInvalidTag, std::memory_order_relaxed);
+			invalidateOverlappedTags(streamData, packetCounter, frameCount);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			const uint8_t* data = reinterpret_cast<const uint8_t*>(&header) + VBAN_HEADER_SIZE;
+			const int pos = static_cast<int>(time & mMask);
+			const int first_frame_count = std::min(frameCount, mSize - pos);
+			if (mLayout == EVBANBufferLayout::Interleaved)
 			{
-				for (int i = 0; i < frameCount; ++i)
+				// Frames are stored as received, convert straight into the buffer
+				convertSamples(header.format_bit, data, first_frame_count * channelCount, streamData.mFrames + pos * channelCount);
+				if (first_frame_count < frameCount)
+					convertSamples(header.format_bit, data + first_frame_count * channelCount * sample_size, (frameCount - first_frame_count) * channelCount, streamData.mFrames);
+			}
+			else {
+				// Convert the whole packet at once, then deinterleave into the planes
+				std::array<float, utility::VBAN_MAX_PACKET_SAMPLE_COUNT> samples;
+				convertSamples(header.format_bit, data, frameCount * channelCount, samples.data());
+
+				std::array<float*, utility::VBAN_MAX_CHANNEL_COUNT> channels;
+				for (auto channel = 0; channel < channelCount; ++channel)
+					channels[channel] = streamData.mPlanes[channel].data() + pos;
+				utility::deinterleaveVBANFrames(samples.data(), first_frame_count, channelCount, channelCount, channels.data());
+
+				if (first_frame_count < frameCount)
 				{
-					for (int ch = 0; ch < channelCount; ++ch)
-					{
-						unsigned char b1 = data[0];
-						unsigned char b2 = data[1];
-						int16_t ival = static_cast<int16_t>(b2) << 8 | (0x00ff & b1);
-						float f = static_cast<float>(ival) / static_cast<float>(std::numeric_limits<int16_t>::max());
-						streamBuffer->mData[ch][pos] = f;
-						data += 2;
-					}
-					pos++;
-					if (pos >= mSize) pos = 0;
+					for (auto channel = 0; channel < channelCount; ++channel)
+						channels[channel] = streamData.mPlanes[channel].data();
+					utility::deinterleaveVBANFrames(samples.data() + first_frame_count * channelCount, frameCount - first_frame_count, channelCount, channelCount, channels.data());
 				}
 			}
+			tag.store(packetCounter, std::memory_order_release);
 		}
 
-		// Update the write position using time derived from packet counter and frame count
-		if (time > mWritePosition)
-			mWritePosition = time;
-		if (time == 0 && mWritePosition != 0)
+		// Update the write position of the timeline of the stream using time derived from packet counter and frame count.
+		// A sender that restarts only resets the streams on its timeline.
+		auto write_position = timeline.mWritePosition.load();
+		while (engine_time > write_position && !timeline.mWritePosition.compare_exchange_weak(write_position, engine_time));
+		if (restart && timeline.mWritePosition.exchange(0) != 0)
 		{
-			mWritePosition = 0;
-			mResetReadPosition.set();
+			// Packets of the new sequence are not late until the read position is reset
+			timeline.mSharedReadPosition.store(std::numeric_limits<int64>::min(), std::memory_order_relaxed);
+			timeline.mResetReadPosition.set();
 		}
 
-		// Write successful, clear error message once
-		if (!mErrorMessage.empty())
-		{
-			std::lock_guard<std::mutex> lock(mErrorMessageMutex);
-			mErrorMessage.clear();
-		}
+		// Write successful, clear error once
+		if (mError.load(std::memory_order_relaxed) >= 0)
+			mError.store(-1, std::memory_order_relaxed);
 
 		return true;
 	}
 
 
-	void VBANCircularBuffer::addStream(const std::string &name, int channelCount)
+	bool VBANCircularBuffer::addStream(const std::string &name, int channelCount, const std::vector<VBANEndpoint>& allowedSources, const std::string& syncGroup)
 	{
-		auto buffer = std::make_unique<ProtectedBuffer>();
-		buffer->mData.resize(channelCount, mSize);
+		// A stream that accepts any sender is registered under the wildcard endpoint
+		std::vector<VBANEndpoint> sources = allowedSources;
+		if (sources.empty())
+			sources.emplace_back();
+
+		// Allocate the stream up front, the update only publishes it
+		auto stream = std::make_shared<Stream>();
+		auto data = std::make_shared<StreamData>(channelCount, mSize, mLayout);
 
+		bool success = false;
+		mRegistry.update([&](StreamRegistry& registry)
 		{
-			std::lock_guard<std::mutex> lock(mBufferMapMutex);
-			mBufferMap[name] = std::move(buffer);
-			++mStreamCount;
-		}
+			// Each sender endpoint can only feed one stream with a given name
+			for (auto& source : sources)
+			{
+				if (registry.mTable.find(VBANStreamKey(name, source)) != nullptr)
+				{
+					nap::Logger::error("VBANCircularBuffer: Stream %s is already received from the same source.", name.c_str());
+					return;
+				}
+			}
 
-		// Reset read and write pointers
-		mWritePosition = 0;
-		mReadPosition = 0;
+			auto slot = std::find_if(registry.mSlots.begin(), registry.mSlots.end(), [](const StreamSlot& candidate) { return candidate.mStream == nullptr; });
+			if (slot == registry.mSlots.end() || registry.mTable.getSize() + static_cast<int>(sources.size()) > registry.mTable.getMaxSize())
+			{
+				nap::Logger::error("VBANCircularBuffer: Unable to add stream %s, the maximum of %i streams is reached.", name.c_str(), registry.mTable.getMaxSize());
+				return;
+			}
+
+			// Streams of a sync group share a timeline, any other stream starts a timeline of its own.
+			// A timeline without streams is not accessed by the receiving and audio threads, so it can be reset here.
+			int timeline = -1;
+			auto group = syncGroup.empty() ? registry.mSyncGroups.end() : registry.mSyncGroups.find(syncGroup);
+			if (group != registry.mSyncGroups.end())
+			{
+				timeline = group->second;
+			}
+			else {
+				timeline = static_cast<int>(std::find(registry.mTimelineUsers.begin(), registry.mTimelineUsers.end(), 0) - registry.mTimelineUsers.begin());
+				mTimelines[timeline].mWritePosition.store(0);
+				mTimelines[timeline].mLowestSampleRate.store(0);
+				mTimelines[timeline].mRestart.set();
+				if (!syncGroup.empty())
+					registry.mSyncGroups.emplace(syncGroup, timeline);
+			}
+			registry.mTimelineUsers[timeline]++;
+			stream->mOvertakeBase = mTimelines[timeline].mUnderrunCount.load();
+			stream->mResetBase = mTimelines[timeline].mResetCount.load();
+
+			slot->mStream = stream;
+			slot->mData = data;
+			slot->mTimeline = timeline;
+			const int index = static_cast<int>(slot - registry.mSlots.begin());
+			for (auto& source : sources)
+				registry.mTable.insert(VBANStreamKey(name, source), index);
+			success = true;
+		});
+
+		if (!success)
+			return false;
+		++mStreamCount;
+		return true;
 	}
 
 
-	void VBANCircularBuffer::removeStream(const std::string &name)
+	void VBANCircularBuffer::removeStream(const std::string &name, const std::vector<VBANEndpoint>& allowedSources)
 	{
-		std::lock_guard<std::mutex> lock(mBufferMapMutex);
-		mBufferMap.erase(name);
+		if (findExactStream(mRegistry.getWriterCopy(), getStreamKey(name, allowedSources)) == nullptr)
+			return;
+
+		// Returns once the receiving and audio threads can't access the stream anymore, the stream is released here
+		mRegistry.update([&](StreamRegistry& registry)
+		{
+			auto* index = registry.mTable.find(getStreamKey(name, allowedSources));
+			if (index == nullptr)
+				return;
+
+			// Invalidate the handles to the stream
+			auto& slot = registry.mSlots[*index];
+			slot.mStream = nullptr;
+			slot.mData = nullptr;
+			++slot.mGeneration;
+
+			// The timeline is released with its last stream, a sync group without streams ends
+			if (--registry.mTimelineUsers[slot.mTimeline] == 0)
+			{
+				auto group = std::find_if(registry.mSyncGroups.begin(), registry.mSyncGroups.end(), [&](const auto& entry) { return entry.second == slot.mTimeline; });
+				if (group != registry.mSyncGroups.end())
+					registry.mSyncGroups.erase(group);
+			}
+			slot.mTimeline = -1;
+
+			if (allowedSources.empty())
+			{
+				registry.mTable.erase(VBANStreamKey(name, VBANEndpoint()));
+			}
+			else {
+				for (auto& source : allowedSources)
+					registry.mTable.erase(VBANStreamKey(name, source));
+			}
+		});
 		--mStreamCount;
 	}
 
 
-	void VBANCircularBuffer::read(const std::string &streamName, int channel, audio::SampleBuffer &output)
+	VBANStreamKey VBANCircularBuffer::getStreamKey(const std::string& name, const std::vector<VBANEndpoint>& allowedSources)
+	{
+		return VBANStreamKey(name, allowedSources.empty() ? VBANEndpoint() : allowedSources.front());
+	}
+
+
+	VBANCircularBuffer::StreamHandle VBANCircularBuffer::getStreamHandle(const std::string& name, const std::vector<VBANEndpoint>& allowedSources) const
+	{
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		auto* index = registry->mTable.find(getStreamKey(name, allowedSources));
+		if (index == nullptr)
+			return { };
+		return { *index, registry->mSlots[*index].mGeneration };
+	}
+
+
+	const VBANCircularBuffer::StreamSlot* VBANCircularBuffer::findExactStream(const StreamRegistry& registry, const VBANStreamKey& key)
 	{
+		auto* index = registry.mTable.find(key);
+		return index != nullptr ? &registry.mSlots[*index] : nullptr;
+	}
+
+
+	const VBANCircularBuffer::StreamSlot* VBANCircularBuffer::findStream(const StreamRegistry& registry, const VBANStreamKey& key)
+	{
+		auto* slot = findExactStream(registry, key);
+		if (slot != nullptr)
+			return slot;
+
+		// Allowed source without port
+		VBANStreamKey wildcard = key;
+		wildcard.mSource = key.mSource.anyPort();
+		slot = findExactStream(registry, wildcard);
+		if (slot != nullptr)
+			return slot;
+
+		// Any sender
+		wildcard.mSource = VBANEndpoint();
+		return findExactStream(registry, wildcard);
+	}
+
+
+	void VBANCircularBuffer::read(const StreamHandle& handle, const std::vector<audio::SampleBuffer*>& buffers, VBANResampler& resampler, VBANConcealer& concealer)
+	{
+		auto output_silence = [&buffers]()
+		{
+			for (auto* buffer : buffers)
+				std::fill(buffer->begin(), buffer->end(), 0.f);
+		};
+
+		if (!handle.isValid())
+		{
+			output_silence();
+			return;
+		}
+
+		// The registry is read without locking, the stream stays alive while the section is held
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		auto& slot = registry->mSlots[handle.mIndex];
+		if (slot.mStream == nullptr || slot.mGeneration != handle.mGeneration)
+		{
+			output_silence();
+			return;
+		}
+
 		// The read position can be negative when the stream is reset and the write position is zeroed.
-		if (mReadPosition < 0)
+		const auto& timeline = mTimelines[slot.mTimeline];
+		if (timeline.mReadPosition < 0)
 		{
-			std::fill(output.begin(), output.end(), 0.f);
+			output_silence();
 			return;
 		}
 
-		auto it = mBufferMap.find(streamName);
-		if (it == mBufferMap.end())
+		// Writes go to a region ahead of the read position, reads don't wait for them
+		if (slot.mStream->mWriting.load(std::memory_order_relaxed))
+			mReadContentionCount++;
+
+		// Only read the channels within the bounds of the stream.
+		auto& data = *slot.mData;
+		const int channel_count = std::min<int>(buffers.size(), data.getChannelCount());
+
+		// Output channels beyond the stream are silent, they would otherwise repeat the last callback
+		for (auto channel = channel_count; channel < static_cast<int>(buffers.size()); ++channel)
+			std::fill(buffers[channel]->begin(), buffers[channel]->end(), 0.f);
+		if (channel_count == 0)
+			return;
+
+		std::array<float*, utility::VBAN_MAX_CHANNEL_COUNT> channels;
+		for (auto channel = 0; channel < channel_count; ++channel)
+			channels[channel] = buffers[channel]->data();
+		const auto frame_count = static_cast<int>(buffers.front()->size());
+		auto* active_concealer = concealer.getMode() == EVBANConcealment::Silence ? nullptr : &concealer;
+
+		// Without drift compensation and at the sample rate of the engine the frames are read as they are
+		const int sample_rate = data.mSampleRate.load(std::memory_order_acquire);
+		const int engine_sample_rate = static_cast<int>(getSampleRate());
+		const bool convert = sample_rate != 0 && sample_rate != engine_sample_rate;
+		if (!convert && timeline.mReadStep == 1.0 && timeline.mReadPhase == 0.0)
+		{
+			fetchFrames(data, timeline.mReadPosition, frame_count, channels.data(), channel_count, active_concealer);
 			return;
+		}
 
-		if (it->second->mMutex.try_lock())
+		// Map the read position to the frames of the stream, in integers so the phase stays exact far into the stream
+		int64 position = timeline.mReadPosition;
+		double phase = timeline.mReadPhase;
+		double step = timeline.mReadStep;
+		if (convert)
 		{
-			// Only read if the channel is within the bounds.
-			if (channel < it->second->mData.getChannelCount())
+			const double ratio = static_cast<double>(sample_rate) / engine_sample_rate;
+			const int64 scaled_position = timeline.mReadPosition * sample_rate;
+			phase = (static_cast<double>(scaled_position % engine_sample_rate) + timeline.mReadPhase * sample_rate) / engine_sample_rate;
+			position = scaled_position / engine_sample_rate + static_cast<int64>(std::floor(phase));
+			phase -= std::floor(phase);
+			step *= ratio;
+			resampler.setRatio(ratio);
+		}
+		else {
+			resampler.setRatio(1.0);
+		}
+
+		// Fetch the frames around the read position and interpolate them at the rate of the sender
+		const int input_frame_count = resampler.getInputFrameCount(phase, step, frame_count);
+		float* const* input = resampler.getInputBuffers(channel_count, input_frame_count);
+		if (input == nullptr)
+		{
+			// The resampler was not reserved for this many frames, allocating here could miss the deadline
+			for (auto channel = 0; channel < channel_count; ++channel)
+				std::fill(channels[channel], channels[channel] + frame_count, 0.f);
+			return;
+		}
+		fetchFrames(data, position - resampler.getHistoryFrameCount(), input_frame_count, input, channel_count, active_concealer);
+		resampler.process(input, channel_count, phase, step, frame_count, channels.data());
+	}
+
+
+	void VBANCircularBuffer::fetchFrames(const StreamData& data, int64 time, int count, float* const* channels, int channelCount, VBANConcealer* concealer) const
+	{
+		std::array<float*, utility::VBAN_MAX_CHANNEL_COUNT> destination;
+		auto output_silence = [&](int offset, int frameCount)
+		{
+			for (auto channel = 0; channel < channelCount; ++channel)
+				std::fill(channels[channel] + offset, channels[channel] + offset + frameCount, 0.f);
+		};
+
+		// Frames before the start of the stream are silent
+		int done = 0;
+		if (time < 0)
+		{
+			done = static_cast<int>(std::min<int64>(count, -time));
+			output_silence(0, done);
+		}
+
+		// Packets that were not received or were overwritten by a later lap of the ring are concealed, or output as silence without concealer.
+		// Consecutive packets of equal validity are copied or silenced at once.
+		const int packet_frame_count = data.mPacketFrameCount.load(std::memory_order_acquire);
+		while (done < count)
+		{
+			const int64 frame = time + done;
+			int frame_count = count - done;
+			bool valid = false;
+			int64 first_packet = 0;
+			int64 last_packet = 0;
+			if (packet_frame_count > 0)
 			{
-				auto& buffer = it->second->mData[channel];
-				auto pos = mReadPosition % mSize;
-				for (auto i = 0; i < output.size(); ++i)
-				{
-					output[i] = buffer[pos];
-					buffer[pos] = 0.f;
-					pos++;
-					if (pos >= mSize)
-						pos = 0;
-				}
+				const int64 end = frame + frame_count;
+				first_packet = frame / packet_frame_count;
+				last_packet = first_packet;
+				valid = isPacketValid(data, first_packet, packet_frame_count);
+				while ((last_packet + 1) * packet_frame_count < end && isPacketValid(data, last_packet + 1, packet_frame_count) == valid)
+					++last_packet;
+				frame_count = static_cast<int>(std::min<int64>(frame_count, (last_packet + 1) * packet_frame_count - frame));
+			}
+
+			for (auto channel = 0; channel < channelCount; ++channel)
+				destination[channel] = channels[channel] + done;
+			if (valid)
+			{
+				copyFrames(data, frame, frame_count, destination.data(), channelCount);
+
+				// A writer that overwrote a slot during the copy has changed its tag, the copied frames are then discarded
+				std::atomic_thread_fence(std::memory_order_acquire);
+				for (auto packet = first_packet; packet <= last_packet && valid; ++packet)
+					valid = isPacketValid(data, packet, packet_frame_count);
 			}
+			if (!valid && concealer == nullptr)
+				output_silence(done, frame_count);
+			if (concealer != nullptr)
+				concealer->process(frame, frame_count, valid, destination.data(), channelCount);
+			done += frame_count;
+		}
+	}
+
+
+	void VBANCircularBuffer::invalidateOverlappedTags(StreamData& data, int64 packet, int frameCount)
+	{
+		// Packets that overlap start less than a packet apart in the ring, which puts them at most two slots away.
+		// The last slot is shorter when the packet size doesn't divide the ring, a packet starting two slots before the wrap can reach past it.
+		const int tag_count = (mSize + frameCount - 1) / frameCount;
+		const int slot = getTagSlot(packet, frameCount);
+		const int position = static_cast<int>((packet * frameCount) & mMask);
+		for (auto offset = -2; offset <= 2; ++offset)
+		{
+			if (offset == 0)
+				continue;
 
-			it->second->mMutex.unlock();
+			auto& tag = data.mTags[((slot + offset) % tag_count + tag_count) % tag_count];
+			const uint32_t other = tag.load(std::memory_order_relaxed);
+			if (other == sInvalidTag)
+				continue;
+
+			const int distance = static_cast<int>((static_cast<int64>(other) * frameCount - position) & mMask);
+			if (distance < frameCount || distance > mSize - frameCount)
+				tag.store(sInvalidTag, std::memory_order_relaxed);
 		}
 	}
 
 
-	void VBANCircularBuffer::setStreamChannelCount(const std::string &streamName, int channelCount)
+	bool VBANCircularBuffer::isPacketValid(const StreamData& data, int64 packet, int frameCount) const
 	{
-		std::lock_guard<std::mutex> mapLock(mBufferMapMutex);
+		return data.mTags[getTagSlot(packet, frameCount)].load(std::memory_order_acquire) == static_cast<uint32_t>(packet);
+	}
 
-		auto it = mBufferMap.find(streamName);
-		assert(it != mBufferMap.end());
 
-		auto& buffer = it->second;
-		if (buffer->mData.getChannelCount() != channelCount)
+	void VBANCircularBuffer::copyFrames(const StreamData& data, int64 time, int count, float* const* channels, int channelCount) const
+	{
+		auto pos = static_cast<int>(time & mMask);
+		int done = 0;
+		if (mLayout == EVBANBufferLayout::Interleaved)
 		{
-			std::lock_guard<std::mutex> bufferLock(buffer->mMutex);
-			buffer->mData.resize(channelCount, mSize);
+			std::array<float*, utility::VBAN_MAX_CHANNEL_COUNT> destination;
+			const int frame_size = data.getChannelCount();
+			while (done < count)
+			{
+				const int segment = std::min(count - done, mSize - pos);
+				for (auto channel = 0; channel < channelCount; ++channel)
+					destination[channel] = channels[channel] + done;
+				utility::deinterleaveVBANFrames(data.mFrames + pos * frame_size, segment, channelCount, frame_size, destination.data());
+				done += segment;
+				pos = 0;
+			}
+			return;
+		}
+
+		while (done < count)
+		{
+			const int segment = std::min(count - done, mSize - pos);
+			for (auto channel = 0; channel < channelCount; ++channel)
+			{
+				const float* source = data.mPlanes[channel].data() + pos;
+				std::copy(source, source + segment, channels[channel] + done);
+			}
+			done += segment;
+			pos = 0;
 		}
 	}
 
 
+	void VBANCircularBuffer::setStreamChannelCount(const std::string &streamName, int channelCount, const std::vector<VBANEndpoint>& allowedSources)
+	{
+		auto* slot = findExactStream(mRegistry.getWriterCopy(), getStreamKey(streamName, allowedSources));
+		assert(slot != nullptr);
+		if (slot->mData->getChannelCount() == channelCount)
+			return;
+
+		// Publish a resized buffer, the previous one is released once no reader can access it anymore
+		auto data = std::make_shared<StreamData>(channelCount, mSize, mLayout);
+		mRegistry.update([&](StreamRegistry& registry)
+		{
+			auto* index = registry.mTable.find(getStreamKey(streamName, allowedSources));
+			if (index != nullptr)
+				registry.mSlots[*index].mData = data;
+		});
+	}
+
+
 	void VBANCircularBuffer::setLatency(int latency)
 	{
 		mLatencyInBuffers.store(latency);
@@ -213,79 +683,445 @@ namespace nap
 	}
 
 
-	void VBANCircularBuffer::getErrorMessage(std::string &message) const
+	float VBANCircularBuffer::getLatency() const
+	{
+		int latency = 0;
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		for (auto index = 0; index < static_cast<int>(registry->mTimelineUsers.size()); ++index)
+			if (registry->mTimelineUsers[index] > 0)
+				latency = std::max(latency, mTimelines[index].mRealLatency.load());
+		return latency / getNodeManager().getSamplesPerMillisecond();
+	}
+
+
+	float VBANCircularBuffer::getTargetLatency() const
+	{
+		int latency = 0;
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		for (auto index = 0; index < static_cast<int>(registry->mTimelineUsers.size()); ++index)
+			if (registry->mTimelineUsers[index] > 0)
+				latency = std::max(latency, mTimelines[index].mTargetLatency.load());
+		return latency / getNodeManager().getSamplesPerMillisecond();
+	}
+
+
+	bool VBANCircularBuffer::getTimelineStatus(const VBANStreamKey& key, TimelineStatus& status) const
 	{
-		if (mErrorMessageMutex.try_lock())
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		auto* slot = findExactStream(*registry, key);
+		if (slot == nullptr)
+			return false;
+		const auto& timeline = mTimelines[slot->mTimeline];
+		const float samples_per_millisecond = getNodeManager().getSamplesPerMillisecond();
+		status.mLatency = timeline.mRealLatency.load() / samples_per_millisecond;
+		status.mTargetLatency = timeline.mTargetLatency.load() / samples_per_millisecond;
+		status.mReadRate = timeline.mReadRate.load();
+		status.mUnderrunCount = timeline.mUnderrunCount.load();
+		return true;
+	}
+
+
+	bool VBANCircularBuffer::getReceiveStatistics(const VBANStreamKey& key, VBANReceiveStatistics::Snapshot& snapshot) const
+	{
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		auto* slot = findExactStream(*registry, key);
+		if (slot == nullptr)
+			return false;
+		getReceiveStatistics(*slot, snapshot);
+		return true;
+	}
+
+
+	void VBANCircularBuffer::getReceiveStatistics(VBANReceiveStatistics::Snapshot& snapshot) const
+	{
+		snapshot = { };
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		for (auto& slot : registry->mSlots)
 		{
-			message = mErrorMessage;
-			mErrorMessageMutex.unlock();
+			if (slot.mStream == nullptr)
+				continue;
+			VBANReceiveStatistics::Snapshot stream_snapshot;
+			getReceiveStatistics(slot, stream_snapshot);
+			snapshot.add(stream_snapshot);
 		}
 	}
 
 
-	void VBANCircularBuffer::process()
+	bool VBANCircularBuffer::getPathStatistics(const VBANStreamKey& key, int path, VBANReceiveStatistics::Snapshot& snapshot) const
 	{
-		if (mResetReadPosition.check())
+		assert(path >= 0 && path < sMaxPathCount);
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		auto* slot = findExactStream(*registry, key);
+		if (slot == nullptr)
+			return false;
+		slot->mStream->mPathStatistics[path].getSnapshot(snapshot);
+		return true;
+	}
+
+
+	void VBANCircularBuffer::getPathStatistics(int path, VBANReceiveStatistics::Snapshot& snapshot) const
+	{
+		assert(path >= 0 && path < sMaxPathCount);
+		snapshot = { };
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		for (auto& slot : registry->mSlots)
 		{
-			resetReadPosition();
+			if (slot.mStream == nullptr)
+				continue;
+			VBANReceiveStatistics::Snapshot stream_snapshot;
+			slot.mStream->mPathStatistics[path].getSnapshot(stream_snapshot);
+			snapshot.add(stream_snapshot);
 		}
-		else
+	}
+
+
+	void VBANCircularBuffer::getReceiveStatistics(const StreamSlot& slot, VBANReceiveStatistics::Snapshot& snapshot) const
+	{
+		slot.mStream->mReceiveStatistics.getSnapshot(snapshot);
+		const auto& timeline = mTimelines[slot.mTimeline];
+		snapshot.mOvertakeCount = timeline.mUnderrunCount.load() - slot.mStream->mOvertakeBase;
+		snapshot.mResetCount = timeline.mResetCount.load() - slot.mStream->mResetBase;
+	}
+
+
+	bool VBANCircularBuffer::getJitterStatistics(const VBANStreamKey& key, VBANJitterStatistics::Snapshot& snapshot) const
+	{
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		auto* slot = findExactStream(*registry, key);
+		if (slot == nullptr)
+			return false;
+		slot->mStream->mJitterStatistics.getSnapshot(snapshot);
+		return true;
+	}
+
+
+	void VBANCircularBuffer::resetJitterStatistics(const VBANStreamKey& key)
+	{
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		auto* slot = findExactStream(*registry, key);
+		if (slot != nullptr)
+			slot->mStream->mJitterStatistics.reset();
+	}
+
+
+	void VBANCircularBuffer::getErrorMessage(std::string &message) const
+	{
+		const int error = mError.load();
+		if (error < 0)
+		{
+			message.clear();
+			return;
+		}
+
+		VBANEventQueue::Event event;
+		event.mType = static_cast<EVBANEvent>(error);
+		event.mValue = mErrorValue.load();
+		event.mStreamName.fill('\0');
+		message = VBANEventQueue::getMessage(event);
+	}
+
+
+	// Largest deviation of the read rate from the sample rate, far above the drift of audio clocks
+	static constexpr double sMaxDrift = 0.002;
+
+	// Gains of the drift controller per window, low enough that jitter of the fill level barely modulates the rate
+	static constexpr double sDriftProportionalGain = 0.2;
+	static constexpr double sDriftIntegralGain = 0.02;
+
+	// Largest deviation of the read rate while adaptive latency moves the read position, a pitch shift of under 9 cents
+	static constexpr double sMaxLatencySlew = 0.005;
+
+
+	void VBANCircularBuffer::process()
+	{
+		// Configuration changes apply to every timeline
+		const bool adaptive_latency_changed = mAdaptiveLatencyChanged.check();
+		const bool drift_compensation_changed = mDriftCompensationChanged.check();
+		const bool reset_read_position = mResetReadPosition.check();
+
+		// Only timelines of streams in the registry are advanced
+		VBANReadCopyUpdate<StreamRegistry>::ReadSection registry(mRegistry);
+		for (auto index = 0; index < static_cast<int>(registry->mTimelineUsers.size()); ++index)
 		{
-			// Increase the read position of the circular buffer.
-			mReadPosition += getBufferSize();
-			mRealLatency = mWritePosition - mReadPosition;
+			if (registry->mTimelineUsers[index] == 0)
+				continue;
+			auto& timeline = mTimelines[index];
 
-			// If the read position overtakes the write position, reset the latency.
-			if (mRealLatency < getBufferSize())
+			// A timeline that was assigned to new streams starts over
+			if (timeline.mRestart.check())
 			{
-				// This check is to avoid changing the read position when no audio is coming in.
-				if (mWritePosition == mLastWritePosition)
-				{
-					mReadPosition = mWritePosition - (mLatencyInBuffers.load() * getBufferSize());
-					mLastWritePosition = mWritePosition;
-					return;
-				}
-				Logger::info("VBANCircularBuffer: Read position overtaking write position.");
-				resetReadPosition();
+				restartTimeline(timeline);
+				timeline.mSharedReadPosition.store(timeline.mReadPosition, std::memory_order_relaxed);
+				continue;
+			}
+
+			// Start adapting from the maximum latency, so the latency only comes down as far as the network allows
+			if (adaptive_latency_changed)
+			{
+				timeline.mJitterEstimate = mMaxLatency.load() * getNodeManager().getSamplesPerMillisecond();
+				timeline.mReadStep = timeline.mDriftStep;
+				timeline.mReadRate.store(timeline.mReadStep);
+				resetLatencyWindow(timeline);
 			}
 
-			// If the read position is too far behind, reset the latency.
-			else if (mWritePosition - mReadPosition > mSize)
+			// Read at the sample rate again, the controller restarts when enabled
+			if (drift_compensation_changed)
 			{
-				Logger::debug("VBANCircularBuffer: Read position too far behind.");
-				resetReadPosition();
+				timeline.mReadStep = 1.0;
+				timeline.mDriftStep = 1.0;
+				timeline.mReadPhase = 0.0;
+				timeline.mDriftIntegral = 0.0;
+				timeline.mDriftSetpoint = -1;
+				timeline.mReadRate.store(1.0);
+				resetLatencyWindow(timeline);
 			}
 
-			mLastWritePosition = mWritePosition;
+			// Both flags are checked, so a reset of the timeline is never left pending
+			const bool reset = timeline.mResetReadPosition.check();
+			if (reset || reset_read_position)
+			{
+				resetReadPosition(timeline);
+				timeline.mResetCount++;
+			}
+			else {
+				processTimeline(timeline);
+			}
+			timeline.mSharedReadPosition.store(timeline.mReadPosition, std::memory_order_relaxed);
 		}
 	}
 
 
-	void VBANCircularBuffer::resetReadPosition()
+	void VBANCircularBuffer::processTimeline(Timeline& timeline)
 	{
-		double timeInMinutes = getNodeManager().getSampleTime() / (getNodeManager().getSamplesPerMillisecond() * 60000.f);
-		Logger::info("VBANCircularBuffer: resetting read position. Time: %.2f", timeInMinutes);
-		mReadPosition = mWritePosition - (mLatencyInBuffers.load() * getBufferSize());
+		// Increase the read position of the circular buffer by the frames read in the previous callback, keeping the fraction in the phase.
+		const double advance = timeline.mReadPhase + getBufferSize() * timeline.mReadStep;
+		const double frames = std::floor(advance);
+		timeline.mReadPosition += static_cast<nap::int64>(frames);
+		timeline.mReadPhase = advance - frames;
+		const nap::int64 write_position = timeline.mWritePosition.load();
+		timeline.mRealLatency = write_position - timeline.mReadPosition;
+
+		// Interpolation needs frames beyond the buffer
+		const int64 frames_needed = static_cast<int64>(std::floor(timeline.mReadPhase + (getBufferSize() - 1) * timeline.mReadStep)) + 1 + getInterpolationLookahead(timeline);
+
+		// If the read position overtakes the write position, reset the latency.
+		if (timeline.mRealLatency < frames_needed)
+		{
+			// This check is to avoid changing the read position when no audio is coming in.
+			if (write_position == timeline.mLastWritePosition)
+			{
+				timeline.mReadPosition = write_position - getLatencyInSamples(timeline);
+				return;
+			}
+			mEvents.post(EVBANEvent::ReadPositionOvertaking);
+			registerUnderrun(timeline);
+			resetReadPosition(timeline);
+			timeline.mResetCount++;
+		}
+
+		// If the read position is too far behind, reset the latency.
+		else if (write_position - timeline.mReadPosition > mSize)
+		{
+			mEvents.post(EVBANEvent::ReadPositionBehind);
+			resetReadPosition(timeline);
+			timeline.mResetCount++;
+		}
+
+		else if (mAdaptiveLatency.load() || mDriftCompensation.load())
+		{
+			updateLatencyWindow(timeline);
+		}
+
+		timeline.mLastWritePosition = write_position;
+	}
+
+
+	void VBANCircularBuffer::restartTimeline(Timeline& timeline)
+	{
+		timeline.mLastWritePosition = timeline.mWritePosition.load();
+		timeline.mReadStep = 1.0;
+		timeline.mDriftStep = 1.0;
+		timeline.mReadPhase = 0.0;
+		timeline.mDriftIntegral = 0.0;
+		timeline.mReadRate.store(1.0);
+		timeline.mJitterEstimate = mMaxLatency.load() * getNodeManager().getSamplesPerMillisecond();
+		resetReadPosition(timeline);
+	}
+
+
+	void VBANCircularBuffer::resetReadPosition(Timeline& timeline)
+	{
+		mEvents.post(EVBANEvent::ReadPositionReset, static_cast<int64>(getNodeManager().getSampleTime() / getNodeManager().getSamplesPerMillisecond()));
+		if (mAdaptiveLatency.load())
+			updateTargetLatency(timeline);
+		else
+			timeline.mTargetLatency = static_cast<int>(getLatencyInSamples(timeline));
+		timeline.mReadPosition = static_cast<nap::int64>(timeline.mWritePosition.load()) - getLatencyInSamples(timeline);
+		timeline.mDriftSetpoint = -1;
+
+		// Stop slewing towards the previous target, the clock drift is kept
+		timeline.mReadStep = timeline.mDriftStep;
+		timeline.mReadRate.store(timeline.mReadStep);
+		resetLatencyWindow(timeline);
+	}
+
+
+	int64 VBANCircularBuffer::getLatencyInSamples(const Timeline& timeline) const
+	{
+		return mAdaptiveLatency.load() ? timeline.mTargetLatency.load() : static_cast<int64>(mLatencyInBuffers.load()) * getBufferSize();
+	}
+
+
+	double VBANCircularBuffer::getMaxReadStep(float sampleRate)
+	{
+		return static_cast<double>(utility::getVBANMaxSampleRate()) / std::max(sampleRate, 1.f) * (1.0 + sMaxDrift + sMaxLatencySlew);
+	}
+
+
+	int64 VBANCircularBuffer::getInterpolationLookahead(const Timeline& timeline) const
+	{
+		// Streams are interpolated when converted, when the read rate follows the clock drift and while adaptive latency slews the read position
+		const int lowest_sample_rate = timeline.mLowestSampleRate.load();
+		if (!mDriftCompensation.load() && !mAdaptiveLatency.load() && lowest_sample_rate == 0)
+			return 0;
+
+		// Half the filter in frames of the stream with the lowest sample rate, converted to frames of the engine
+		const auto engine_sample_rate = static_cast<int64>(getSampleRate());
+		const int64 sample_rate = lowest_sample_rate == 0 ? engine_sample_rate : std::min<int64>(lowest_sample_rate, engine_sample_rate);
+		return (VBANResampler::sMaxTapCount / 2 * engine_sample_rate + sample_rate - 1) / sample_rate;
+	}
+
+
+	void VBANCircularBuffer::registerUnderrun(Timeline& timeline)
+	{
+		mUnderrunCount++;
+		timeline.mUnderrunCount++;
+		if (!mAdaptiveLatency.load())
+			return;
+
+		// The audio arrived at least this much later than on time, raise the estimate beyond it at once
+		const int64 lateness = std::max<int64>(timeline.mWindowMaxLatency, timeline.mTargetLatency.load()) - timeline.mRealLatency.load();
+		timeline.mJitterEstimate = std::max(timeline.mJitterEstimate, static_cast<double>(lateness)) + getBufferSize() / 2;
+		resetLatencyWindow(timeline);
+	}
+
+
+	void VBANCircularBuffer::updateLatencyWindow(Timeline& timeline)
+	{
+		const int64 real_latency = timeline.mRealLatency.load();
+		timeline.mWindowMinLatency = std::min(timeline.mWindowMinLatency, real_latency);
+		timeline.mWindowMaxLatency = std::max(timeline.mWindowMaxLatency, real_latency);
+		timeline.mWindowFrames += getBufferSize();
+		if (timeline.mWindowFrames < getSampleRate())
+			return;
+
+		if (mAdaptiveLatency.load())
+		{
+			// Follow increases at once and decreases slowly, so the latency only falls after the network was calm for a while
+			const auto spread = static_cast<double>(timeline.mWindowMaxLatency - timeline.mWindowMinLatency);
+			if (spread > timeline.mJitterEstimate)
+				timeline.mJitterEstimate = spread;
+			else
+				timeline.mJitterEstimate += (spread - timeline.mJitterEstimate) * 0.1;
+			updateTargetLatency(timeline);
+		}
+
+		// Move the fill level of audio that arrived on time towards the target, ignoring differences smaller than a quarter buffer.
+		// The read position is slewed by reading slightly slower or faster during the next window, a jump would click.
+		// The drift controller takes care of differences within a buffer.
+		const int64 difference = timeline.mTargetLatency.load() - timeline.mWindowMaxLatency;
+		const int64 threshold = mDriftCompensation.load() ? getBufferSize() : getBufferSize() / 4;
+		double slew = 0.0;
+		if (mAdaptiveLatency.load() && std::abs(difference) >= threshold)
+			slew = std::clamp(-static_cast<double>(difference) / timeline.mWindowFrames, -sMaxLatencySlew, sMaxLatencySlew);
+		else if (mDriftCompensation.load())
+			updateDriftCompensation(timeline);
+		timeline.mReadStep = timeline.mDriftStep + slew;
+		timeline.mReadRate.store(timeline.mReadStep);
+		resetLatencyWindow(timeline);
+	}
+
+
+	void VBANCircularBuffer::updateDriftCompensation(Timeline& timeline)
+	{
+		// Without adaptive latency the fill level is kept where it was found after the last reset
+		if (mAdaptiveLatency.load())
+			timeline.mDriftSetpoint = timeline.mTargetLatency.load();
+		else if (timeline.mDriftSetpoint < 0)
+		{
+			timeline.mDriftSetpoint = timeline.mWindowMaxLatency;
+			return;
+		}
+
+		// A fill level above the setpoint means the sender runs faster, read faster to bring it back
+		const double error = static_cast<double>(timeline.mWindowMaxLatency - timeline.mDriftSetpoint);
+		const double max_correction = sMaxDrift * timeline.mWindowFrames;
+		timeline.mDriftIntegral = std::clamp(timeline.mDriftIntegral + sDriftIntegralGain * error, -max_correction, max_correction);
+		const double correction = std::clamp(sDriftProportionalGain * error + timeline.mDriftIntegral, -max_correction, max_correction);
+		timeline.mDriftStep = 1.0 + correction / timeline.mWindowFrames;
+	}
+
+
+	void VBANCircularBuffer::resetLatencyWindow(Timeline& timeline)
+	{
+		timeline.mWindowMinLatency = std::numeric_limits<int64>::max();
+		timeline.mWindowMaxLatency = 0;
+		timeline.mWindowFrames = 0;
+	}
+
+
+	void VBANCircularBuffer::updateTargetLatency(Timeline& timeline)
+	{
+		// A full buffer has to be available when reading late audio, with a quarter buffer of headroom on top of the estimated jitter
+		const float samples_per_millisecond = getNodeManager().getSamplesPerMillisecond();
+		const int64 min_latency = static_cast<int64>(mMinLatency.load() * samples_per_millisecond);
+		const int64 max_latency = std::min<int64>(static_cast<int64>(mMaxLatency.load() * samples_per_millisecond), mSize - getBufferSize());
+		int64 target = getBufferSize() + getBufferSize() / 4 + static_cast<int64>(std::ceil(timeline.mJitterEstimate));
+		target += getInterpolationLookahead(timeline);
+		timeline.mTargetLatency = static_cast<int>(std::clamp(target, std::min(min_latency, max_latency), max_latency));
+	}
+
+
+	void VBANCircularBuffer::setAdaptiveLatency(bool enabled, float minLatency, float maxLatency)
+	{
+		mMinLatency.store(minLatency);
+		mMaxLatency.store(maxLatency);
+		mAdaptiveLatency.store(enabled);
+		mAdaptiveLatencyChanged.set();
+		mResetReadPosition.set();
+	}
+
+
+	void VBANCircularBuffer::setDriftCompensation(bool enabled)
+	{
+		mDriftCompensation.store(enabled);
+		mDriftCompensationChanged.set();
 	}
 
 
 	bool VBANCircularBuffer::checkPacket(const VBanHeader& header, size_t size)
 	{
+		if (size < VBAN_HEADER_SIZE)
+		{
+			setError(EVBANEvent::PacketTooSmall);
+			return false;
+		}
+
 		if (size > VBAN_PROTOCOL_MAX_SIZE)
 		{
-			setError("Packet exceeds maximum size.");
+			setError(EVBANEvent::PacketTooLarge);
 			return false;
 		}
 
 		if (header.vban != *reinterpret_cast<const int32_t*>("VBAN"))
 		{
-			setError("Invalid packet header ID.");
+			setError(EVBANEvent::InvalidHeader);
 			return false;
 		}
 
 		if (header.format_nbc < 0)
 		{
-			setError("Channel count should be greater than zero.");
+			setError(EVBANEvent::InvalidChannelCount);
 			return false;
 		}
 
@@ -293,7 +1129,7 @@ namespace nap
 		auto protocol = static_cast<VBanProtocol>(header.format_SR & VBAN_PROTOCOL_MASK);
 		if (protocol != VBAN_PROTOCOL_AUDIO)
 		{
-			setError("Invalid protocol ID, only audio protocol supported.");
+			setError(EVBANEvent::UnsupportedProtocol);
 			return false;
 		}
 
@@ -301,7 +1137,7 @@ namespace nap
 		auto codec = static_cast<VBanCodec>(header.format_bit & VBAN_CODEC_MASK);
 		if (codec != VBAN_CODEC_PCM)
 		{
-			setError("Invalid codec ID, only PCM codec supported.");
+			setError(EVBANEvent::UnsupportedCodec);
 			return false;
 		}
 
@@ -309,21 +1145,20 @@ namespace nap
 	}
 
 
-	void VBANCircularBuffer::setError(const std::string &errorMessage)
+	void VBANCircularBuffer::setError(EVBANEvent error, int64 value, const char* streamName)
 	{
-		std::lock_guard<std::mutex> lock(mErrorMessageMutex);
-		mErrorMessage = errorMessage;
+		// Every packet of a faulty stream fails the same way, only a change of error is logged
+		mErrorValue.store(value, std::memory_order_relaxed);
+		if (mError.exchange(static_cast<int>(error)) != static_cast<int>(error))
+			mEvents.post(error, value, streamName);
 	}
 
 
-	void VBANCircularBufferReader::init(const audio::SafePtr<VBANCircularBuffer>& circularBuffer, const std::string &streamName, int channelCount)
+	void VBANCircularBufferReader::init(const audio::SafePtr<VBANCircularBuffer>& circularBuffer, const std::string &streamName, int channelCount, const std::vector<VBANEndpoint>& allowedSources)
 	{
 		mCircularBuffer = circularBuffer;
-		mStreamName = streamName;
-
-		// Create output pins
-		for (int channel = 0; channel < channelCount; ++channel)
-			mOutputPins.emplace_back(std::make_unique<audio::OutputPin>(this));
+		mStreamHandle = mCircularBuffer->getStreamHandle(streamName, allowedSources);
+		setChannelCount(channelCount);
 	}
 
 
@@ -333,16 +1168,37 @@ namespace nap
 		mOutputPins.clear();
 		for (int channel = 0; channel < channelCount; ++channel)
 			mOutputPins.emplace_back(std::make_unique<audio::OutputPin>(this));
+		mOutputBuffers.resize(channelCount, nullptr);
+		mConcealer.setChannelCount(channelCount);
+		reserveResampler();
+	}
+
+
+	void VBANCircularBufferReader::reserveResampler()
+	{
+		mResampler.setSampleRate(getSampleRate());
+		mResampler.reserve(getChannelCount(), getBufferSize(), VBANCircularBuffer::getMaxReadStep(getSampleRate()));
+	}
+
+
+	void VBANCircularBufferReader::setConcealment(EVBANConcealment concealment)
+	{
+		getNodeManager().enqueueTask([&, concealment](){ mConcealer.setMode(concealment); });
+	}
+
+
+	void VBANCircularBufferReader::setResamplerQuality(EVBANResamplerQuality quality)
+	{
+		// Builds the tables on this thread, the audio thread picks them up without allocating
+		mResampler.setQuality(quality);
 	}
 
 
 	void VBANCircularBufferReader::process()
 	{
 		for (auto channel = 0; channel < mOutputPins.size(); ++channel)
-		{
-			auto& outputBuffer = getOutputBuffer(*mOutputPins[channel]);
-			mCircularBuffer->read(mStreamName, channel, outputBuffer);
-		}
+			mOutputBuffers[channel] = &getOutputBuffer(*mOutputPins[channel]);
+		mCircularBuffer->read(mStreamHandle, mOutputBuffers, mResampler, mConcealer);
 	}
 
 }
@@ -6,74 +6,172 @@
 #include <audio/utility/dirtyflag.h>
 #include <audio/core/audionodemanager.h>
 
+#include <array>
+#include <limits>
+#include <map>
+
 #include <vbanutils.h>
+#include <vbanpacket.h>
+#include <vbanstreamkey.h>
+#include <vbanjitterstatistics.h>
+#include <vbanreceivestatistics.h>
+#include <vbanstreamtable.h>
+#include <vbanreadcopyupdate.h>
+#include <vbanresampler.h>
+#include <vbanconcealment.h>
+#include <vbaneventqueue.h>
 
 namespace nap
 {
 	/**
-	 * An audio process that manages a circular buffer to receive the input of all incoming VBAN streams from a single sender.
-	 * It takes care of synchronication and a global read position to ensure all streams are read and played back in sync.
+	 * Memory layout of the audio of a stream in the circular buffer.
+	 */
+	enum class EVBANBufferLayout : int
+	{
+		Planar		= 0,	///< One buffer per channel, packets are deinterleaved on write
+		Interleaved	= 1		///< All channels in a single cache line aligned buffer, packets are copied as a whole on write and deinterleaved one audio block at a time on read
+	};
+
+
+	/**
+	 * An audio process that manages a circular buffer to receive the input of all incoming VBAN streams.
+	 * Every stream is read from a timeline of its own, with its own write and read position, latency and drift compensation,
+	 * so a sender that restarts or stalls doesn't disturb the streams of other senders.
+	 * Streams that have to play back sample-aligned are added to the same sync group, they share a timeline.
 	 */
 	class NAPAPI VBANCircularBuffer : public audio::Process
 	{
 		RTTI_ENABLE(audio::Process)
 
 	public:
+		static constexpr int sMaxPathCount = 2;		///< Number of redundant network paths a stream can be received over
+
+		/**
+		 * Refers to a stream in the circular buffer, resolved once so the audio thread can read without looking up the stream.
+		 * A handle becomes invalid when its stream is removed, reading through it then outputs silence.
+		 */
+		struct StreamHandle
+		{
+			int mIndex = -1;				///< Slot of the stream
+			uint32_t mGeneration = 0;		///< Generation of the slot when the handle was resolved
+
+			/**
+			 * @return If the handle refers to a stream, which might have been removed since.
+			 */
+			bool isValid() const { return mIndex >= 0; }
+		};
+
 		/**
 		 * Constructor
 		 * @param nodeManager The NodeManager of the system
+		 * @param size Size of the circular buffer in samples, rounded up to a power of two so positions wrap by masking
+		 * @param maxStreamCount Maximum number of streams, a stream with multiple allowed sources counts once for every source
+		 * @param layout Memory layout of the audio of every stream
 		 */
-		VBANCircularBuffer(audio::NodeManager& nodeManager, int size);
+		VBANCircularBuffer(audio::NodeManager& nodeManager, int size, int maxStreamCount = 64, EVBANBufferLayout layout = EVBANBufferLayout::Planar);
+
+		/**
+		 * @return The size of the circular buffer in samples, always a power of two.
+		 */
+		int getSize() const { return mSize; }
+
+		/**
+		 * @return The memory layout of the audio of every stream.
+		 */
+		EVBANBufferLayout getLayout() const { return mLayout; }
 
 		// Called from control thread
 
 		/**
 		 * Adds a VBAN stream to receive into the circular buffer.
+		 * Packets are demultiplexed on stream name and sender endpoint, so equally named streams from different senders can be received side by side.
+		 * Fails when one of the allowed sources of the stream is already taken by another stream with the same name,
+		 * or when the maximum number of streams is reached.
 		 * @param name Name of the stream
 		 * @param channelCount Number of channels in the stream
+		 * @param allowedSources Endpoints the stream is accepted from, a zero port matches any port. Empty accepts the stream from any sender.
+		 * @param syncGroup Streams with the same sync group are read from one timeline and stay sample-aligned. Empty gives the stream a timeline of its own.
+		 * @return True when the stream was added.
 		 */
-		void addStream(const std::string &name, int channelCount);
+		bool addStream(const std::string &name, int channelCount, const std::vector<VBANEndpoint>& allowedSources = {}, const std::string& syncGroup = {});
 
 		/**
 		 * Removes a VBAN stream from the circular buffer.
 		 * @param name Name of the stream to be removed
+		 * @param allowedSources The allowed sources the stream was added with
+		 */
+		void removeStream(const std::string &name, const std::vector<VBANEndpoint>& allowedSources = {});
+
+		/**
+		 * Returns the key that identifies a stream added with the given name and allowed sources, used to read from the stream.
+		 * @param name Name of the stream
+		 * @param allowedSources The allowed sources the stream was added with
+		 * @return The key of the stream
+		 */
+		static VBANStreamKey getStreamKey(const std::string& name, const std::vector<VBANEndpoint>& allowedSources = {});
+
+		/**
+		 * Resolves the handle of a stream, used to read from the stream.
+		 * @param name Name of the stream
+		 * @param allowedSources The allowed sources the stream was added with
+		 * @return The handle of the stream, invalid when the stream was not added.
 		 */
-		void removeStream(const std::string &name);
+		StreamHandle getStreamHandle(const std::string& name, const std::vector<VBANEndpoint>& allowedSources = {}) const;
 
-		// Called from the VBAN receiver thread
+		// Called from the receiving threads of the VBANUDPServer
 
 		/**
-		 *
-		 * @param header
-		 * @param size
-		 * @return
+		 * Converts, deinterleaves and writes the audio data of a received packet into the buffer of its stream.
+		 * The buffer of a stream holds frames at the sample rate of the stream, any sample rate of VBAN is accepted.
+		 * The circular buffer then spans less time for streams with a higher sample rate than the engine's.
+		 * A stream can be received over sMaxPathCount redundant network paths, the copy of a packet that arrives first is written and later copies are dropped.
+		 * Packets older than the packet their slot holds and packets the read position passed are dropped as well.
+		 * Packet 0 restarts the stream when it follows a higher packet counter over a path that carried the current sequence,
+		 * otherwise it is a late first packet or a copy delayed by a redundant path.
+		 * @param packet The received packet
+		 * @param path Network path the packet was received over, the packet is counted in the statistics of that path
+		 * @return True when the packet was written or was already written by an earlier copy.
 		 */
-		bool write(const VBanHeader& header, size_t size);
+		bool write(const VBANPacket& packet, int path = 0);
 
 		// Called from the audio threads
 
 		/**
-		 * Read audio data for a certain stream from the circular buffer.
-		 * Reads from the global read position of the buffer that is increased every audio callback with the current buffer size.
-		 * @param name Name of the stream
-		 * @param channel Channel of the stream the read.
-		 * @param buffer Single channel buffer to read into. The size of the buffer will be read.
+		 * Read audio data for all channels of a stream from the circular buffer in a single pass.
+		 * Reads from the read position of the timeline of the stream, that is increased every audio callback with the current buffer size.
+		 * Outputs silence when the stream was removed and for packets that were not received, channels the stream doesn't have are left untouched.
+		 * The ring is not cleared after reading, every packet slot is tagged with the counter of the packet it holds instead.
+		 * While drift compensation runs the audio is interpolated at the read rate, see setDriftCompensation().
+		 * Streams sent at another sample rate than the engine's are converted to the engine's sample rate.
+		 * @param handle Handle of the stream, see getStreamHandle()
+		 * @param buffers Single channel buffer to read into for every channel. The size of the buffers will be read.
+		 * @param resampler Interpolates the audio while drift compensation runs, one per reader
+		 * @param concealer Replaces the audio of missing packets, unless its mode is EVBANConcealment::Silence. One per reader
+		 */
+		void read(const StreamHandle& handle, const std::vector<audio::SampleBuffer*>& buffers, VBANResampler& resampler, VBANConcealer& concealer);
+
+		/**
+		 * Returns the largest number of stream frames read per output frame, for a stream at the highest VBAN sample rate read at the highest rate.
+		 * Readers reserve their resampler for it, see VBANResampler::reserve(). Thread-Safe
+		 * @param sampleRate Sample rate of the engine
+		 * @return The largest read step
 		 */
-		void read(const std::string &name, int channel, audio::SampleBuffer &buffer);
+		static double getMaxReadStep(float sampleRate);
 
 		/**
 		 * Sets the number of channels received for the given stream.
 		 * @param streamName Name of the stream.
 		 * @param channelCount Number of audio channels.
+		 * @param allowedSources The allowed sources the stream was added with
 		 */
-		void setStreamChannelCount(const std::string& streamName, int channelCount);
+		void setStreamChannelCount(const std::string& streamName, int channelCount, const std::vector<VBANEndpoint>& allowedSources = {});
 
 		// Called from main thread
 
 		/**
-		 * @return The latency in milliseconds, which is equal to the difference between the read and write position.
+		 * @return The highest latency of all timelines in milliseconds, the latency of a timeline is the difference between its read and write position.
 		 */
-		float getLatency() const { return mRealLatency.load() / getNodeManager().getSamplesPerMillisecond(); }
+		float getLatency() const;
 
 		/**
 		 * Sets the latency as a multiplier of the buffersize
@@ -82,7 +180,38 @@ namespace nap
 		void setLatency(int latency);
 
 		/**
-		 * Resets the actual latency to the latency as specified by setLatency().
+		 * Enables or disables adaptive latency, which replaces the latency specified by setLatency() when enabled.
+		 * The audio thread tracks how late audio arrives compared to the current latency and how often the read position overtakes the write position.
+		 * The target latency rises at once when audio arrives later or an underrun occurs, and falls slowly while the network is calm.
+		 * The actual latency follows the target by reading at most 0.5% slower or faster, so the read position never jumps.
+		 * @param enabled True to adapt the latency to the measured network conditions.
+		 * @param minLatency Lower bound of the latency in milliseconds.
+		 * @param maxLatency Upper bound of the latency in milliseconds.
+		 */
+		void setAdaptiveLatency(bool enabled, float minLatency, float maxLatency);
+
+		/**
+		 * @return The highest latency in milliseconds the adaptive latency of a timeline aims for, equal to the specified latency when adaptive latency is disabled.
+		 */
+		float getTargetLatency() const;
+
+		/**
+		 * Enables or disables clock drift compensation.
+		 * The clocks of sender and receiver never run at exactly the same rate, without compensation the latency slowly drifts until the read position is reset.
+		 * With compensation the audio is read at a slightly different rate, steered so the latency of audio that arrives on time stays at the target latency,
+		 * or at the latency found after the last reset when adaptive latency is disabled. The rate deviates at most 2000 ppm from the sample rate.
+		 * Interpolation reads VBANResampler::sMaxTapCount / 2 frames ahead, which adds to the latency.
+		 * @param enabled True to compensate clock drift.
+		 */
+		void setDriftCompensation(bool enabled);
+
+		/**
+		 * @return The number of times the read position of a timeline overtook its write position while audio was coming in, summed over all timelines. Thread-Safe
+		 */
+		int64 getUnderrunCount() const { return mUnderrunCount.load(); }
+
+		/**
+		 * Resets the actual latency of all timelines to the latency as specified by setLatency().
 		 */
 		void reset() { mResetReadPosition.set(); }
 
@@ -92,47 +221,253 @@ namespace nap
 		int getStreamCount() const { return mStreamCount.load(); }
 
 		/**
-		 * Acquire any error logging in a thread-safe manner.
+		 * State of the timeline a stream is read from.
+		 */
+		struct TimelineStatus
+		{
+			float mLatency = 0.f;			///< Difference between the read and write position in milliseconds
+			float mTargetLatency = 0.f;		///< Latency in milliseconds the adaptive latency aims for
+			double mReadRate = 1.0;			///< Rate audio is read at relative to the sample rate, above 1 when the clock of the sender runs faster or adaptive latency lowers the latency
+			int64 mUnderrunCount = 0;		///< Number of times the read position overtook the write position since the circular buffer was created
+		};
+
+		/**
+		 * Copies the state of the timeline a stream is read from, shared with the other streams in its sync group.
+		 * @param key Key of the stream, see getStreamKey()
+		 * @param status Receives the state of the timeline
+		 * @return False when the stream was not found.
+		 */
+		bool getTimelineStatus(const VBANStreamKey& key, TimelineStatus& status) const;
+
+		/**
+		 * Copies the inter-arrival jitter statistics of a stream, measured on the receive timestamps of its packets.
+		 * The statistics are read without blocking the receiving thread.
+		 * @param key Key of the stream, see getStreamKey()
+		 * @param snapshot Receives the statistics
+		 * @return False when the stream was not found.
+		 */
+		bool getJitterStatistics(const VBANStreamKey& key, VBANJitterStatistics::Snapshot& snapshot) const;
+
+		/**
+		 * Copies the packet counters of a stream, counted since the stream was added.
+		 * Over redundant paths a packet is only lost when it was lost on all paths, the copies that arrive after the first are counted as duplicates.
+		 * Overtakes and resets are counted on the timeline of the stream, and so include those of the other streams in its sync group.
+		 * @param key Key of the stream, see getStreamKey()
+		 * @param snapshot Receives the counters
+		 * @return False when the stream was not found.
+		 */
+		bool getReceiveStatistics(const VBANStreamKey& key, VBANReceiveStatistics::Snapshot& snapshot) const;
+
+		/**
+		 * Sums the packet counters of all streams in the circular buffer, streams that were removed are not included.
+		 * @param snapshot Receives the summed counters
+		 */
+		void getReceiveStatistics(VBANReceiveStatistics::Snapshot& snapshot) const;
+
+		/**
+		 * Copies the packet counters of a stream over a single network path, as if the stream was only received over that path.
+		 * Overtakes and resets are not counted per path.
+		 * @param key Key of the stream, see getStreamKey()
+		 * @param path Network path, see write()
+		 * @param snapshot Receives the counters
+		 * @return False when the stream was not found.
+		 */
+		bool getPathStatistics(const VBANStreamKey& key, int path, VBANReceiveStatistics::Snapshot& snapshot) const;
+
+		/**
+		 * Sums the packet counters over a single network path of all streams in the circular buffer.
+		 * @param path Network path, see write()
+		 * @param snapshot Receives the summed counters
+		 */
+		void getPathStatistics(int path, VBANReceiveStatistics::Snapshot& snapshot) const;
+
+		/**
+		 * Clears the jitter statistics of a stream.
+		 * @param key Key of the stream, see getStreamKey()
+		 */
+		void resetJitterStatistics(const VBANStreamKey& key);
+
+		/**
+		 * Returns how often a stream was read while a packet was being written into it.
+		 * Reading and writing used to exclude each other with a lock, the read was then skipped and the previous block was output.
+		 * Now reads never wait nor skip, this counts the blocks that would have been lost.
+		 * @return The number of contended reads since construction. Thread-Safe
+		 */
+		int64 getReadContentionCount() const { return mReadContentionCount.load(); }
+
+		/**
+		 * Returns how often a packet had to wait because another thread was writing into the same stream.
+		 * Only happens when redundant paths or multiple receivers write the same stream, the packet is written once the other thread is done.
+		 * @return The number of packets that waited since construction. Thread-Safe
+		 */
+		int64 getWriteContentionCount() const { return mWriteContentionCount.load(); }
+
+		/**
+		 * Acquire the error of the last packet that could not be written in a thread-safe manner, empty once a packet is written again.
+		 * Errors and the other events of the receiving and audio threads are also logged on the main thread by the VBANService.
 		 * @param message
 		 */
 		void getErrorMessage(std::string& message) const;
 
 	private:
+		// Write and read position of streams that are read in sync.
+		// The atomics are shared with the receiving and control threads, the other state is only accessed by the audio thread.
+		struct Timeline
+		{
+			std::atomic<audio::DiscreteTimeValue> mWritePosition = { 0 };	// Current write position in the circular buffer.
+			audio::DirtyFlag mResetReadPosition;		// Set when a sender of the timeline restarts
+			audio::DirtyFlag mRestart;					// Set when the timeline is assigned to new streams
+			std::atomic<int> mLowestSampleRate = { 0 };	// Lowest sample rate of the streams that are converted, 0 when none is
+			std::atomic<int> mRealLatency = { 0 };
+			std::atomic<int> mTargetLatency = { 0 };	// Samples, fill level the read position aims for with audio that arrives on time
+			std::atomic<double> mReadRate = { 1.0 };	// Copy of mReadStep for the control thread
+			std::atomic<int64> mSharedReadPosition = { 0 };	// Copy of mReadPosition for the receiving thread, to recognize late packets
+			std::atomic<int64> mUnderrunCount = { 0 };	// Only increases, also when the timeline is assigned to new streams
+			std::atomic<int64> mResetCount = { 0 };		// Only increases, also when the timeline is assigned to new streams
+
+			audio::DiscreteTimeValue mLastWritePosition = 0;
+			nap::int64 mReadPosition = 0;				// The read position can be negative when the write position is zeroed.
+			double mReadStep = 1.0;						// Frames read per output frame
+			double mDriftStep = 1.0;					// Read step set by the drift controller, adaptive latency slews the read position on top of it
+			double mReadPhase = 0.0;					// Fractional part of the read position, between 0 and 1
+			double mDriftIntegral = 0.0;				// Integral term of the drift controller in samples per window
+			int64 mDriftSetpoint = -1;					// Fill level the drift controller aims for, -1 until captured after a reset
+			double mJitterEstimate = 0.0;				// Smoothed spread of the fill level in samples
+			int64 mWindowMinLatency = std::numeric_limits<int64>::max();	// Lowest fill level within the current window
+			int64 mWindowMaxLatency = 0;				// Highest fill level within the current window
+			int mWindowFrames = 0;						// Frames read in the current window
+		};
+
 		// Inherited from Process
 		void process() override;
-		void resetReadPosition(); // Called only by process()
+		void processTimeline(Timeline& timeline); // Called only by process()
+		void restartTimeline(Timeline& timeline); // Called only by process()
+		void resetReadPosition(Timeline& timeline); // Called only by process()
+		int64 getLatencyInSamples(const Timeline& timeline) const; // Called only by process()
+		int64 getInterpolationLookahead(const Timeline& timeline) const; // Called only by process()
+		void registerUnderrun(Timeline& timeline); // Called only by process()
+		void updateLatencyWindow(Timeline& timeline); // Called only by process()
+		void updateTargetLatency(Timeline& timeline); // Called only by process()
+		void updateDriftCompensation(Timeline& timeline); // Called only by process()
+		void resetLatencyWindow(Timeline& timeline); // Called only by process()
 		void sampleRateChanged(float sampleRate) override { mResetReadPosition.set(); }
 		void bufferSizeChanged(int bufferSize) override { mResetReadPosition.set(); }
 
 		// Checking packet integrity
 		bool checkPacket(const VBanHeader& header, size_t size);
 
-		// Set error message
-		void setError(const std::string& errorMessage);
+		// Set the error of the last packet, it is logged when it differs from the previous error
+		void setError(EVBANEvent error, int64 value = 0, const char* streamName = nullptr);
+
+		// State of a stream that is kept when the registry is updated
+		struct Stream
+		{
+			std::atomic<bool> mWriting = { false };		// Set while a packet is written into the stream, writers and readers never wait for it
+			VBANJitterStatistics mJitterStatistics;
+			VBANReceiveStatistics mReceiveStatistics;	// Over all paths
+			std::array<VBANReceiveStatistics, sMaxPathCount> mPathStatistics;
+			uint32_t mSequence = 0;						// Number of times the sender restarted, only accessed while writing
+			std::array<uint32_t, sMaxPathCount> mPathSequence = { };	// Sequence every path delivers, a path behind the stream still carries packets from before the restart
+			int64 mOvertakeBase = 0;					// Overtakes of the timeline before the stream was added
+			int64 mResetBase = 0;						// Resets of the timeline before the stream was added
+		};
+
+		// Audio of a stream, stored in the layout of the circular buffer.
+		// Every packet slot of the ring is tagged with the counter of the packet written into it, so stale audio is recognized without clearing it after reading.
+		struct StreamData
+		{
+			StreamData(int channelCount, int size, EVBANBufferLayout layout);
+
+			int getChannelCount() const { return mChannelCount; }
+			void invalidateTags();
+
+			int mChannelCount = 0;
+			int mSize = 0;
+			audio::MultiSampleBuffer mPlanes;	// Planar layout, one buffer per channel
+			std::vector<float> mStorage;		// Interleaved layout, over-allocated to align the frames to a cache line
+			float* mFrames = nullptr;			// Interleaved layout, the frames within mStorage
+			std::unique_ptr<std::atomic<uint32_t>[]> mTags;		// Packet counter for every packet slot, size / mPacketFrameCount rounded up slots are in use
+			std::atomic<int> mPacketFrameCount = { 0 };			// Frames per packet of the stream, 0 until the first packet is received
+			std::atomic<int> mSampleRate = { 0 };				// Sample rate of the stream, 0 until the first packet is received
+		};
 
-		// Map of the (circular) buffer for each stream, protected by a mutex for resizing.
-		struct ProtectedBuffer
+		// Slot of a stream in the registry, handles refer to streams by slot index
+		struct StreamSlot
 		{
-			std::mutex mMutex;
-			audio::MultiSampleBuffer mData;
-			std::atomic<int> mPacketCounter = { 0 };
+			std::shared_ptr<Stream> mStream = nullptr;					// Null when the slot is free
+			std::shared_ptr<StreamData> mData = nullptr;				// Replaced as a whole when the channel count changes
+			uint32_t mGeneration = 0;									// Increased when the stream is removed, invalidates its handles
+			int mTimeline = -1;											// Index of the timeline the stream is read from
+		};
+
+		// Immutable version of the registry, replaced as a whole when streams are added, removed or resized
+		struct StreamRegistry
+		{
+			StreamRegistry(int maxStreamCount) : mTable(maxStreamCount), mSlots(std::max(maxStreamCount, 1)), mTimelineUsers(mSlots.size(), 0) { }
+
+			VBANStreamTable<int> mTable;		// Slot of the stream for each allowed source of a stream, lookups never allocate
+			std::vector<StreamSlot> mSlots;
+			std::vector<int> mTimelineUsers;	// Number of streams read from every timeline, the audio thread only advances timelines in use
+			std::map<std::string, int> mSyncGroups;	// Timeline of every sync group with streams
 		};
-		std::map<std::string, std::unique_ptr<ProtectedBuffer>> mBufferMap;
-		std::mutex mBufferMapMutex;						// Protects the buffer map.
-
-		int mSize = 8192;								// Size of the circular buffer in samples.
-		audio::DiscreteTimeValue mWritePosition = 0;	// Current write position in the circular buffer.
-		audio::DiscreteTimeValue mLastWritePosition = 0;
-		nap::int64 mReadPosition = 0;					// The read position can be negative when the write position is zeroed.
-		std::string mStreamName;						// For internal use, kept here to avoid reallocations.
-		std::atomic<int> mLatencyInBuffers = 0;
-		std::atomic<int> mRealLatency = 0;
-		audio::DirtyFlag mResetReadPosition;			// This flag is set when the read position has to be recalculated from the write position.
+
+		// Read by the receiving and audio threads without blocking, updated on the control thread.
+		// The previous version and the streams only it refers to are released on the control thread once no reader can access them anymore.
+		VBANReadCopyUpdate<StreamRegistry> mRegistry;
+
+		// Packet slot of the ring that a packet starts in, every slot spans a packet of frames.
+		// Derived from the frame position, so packets that overlap in the ring always meet in a slot or invalidate each other, also when the packet size doesn't divide the ring.
+		int getTagSlot(int64 packet, int frameCount) const { return static_cast<int>((packet * frameCount) & mMask) / frameCount; }
+
+		// Invalidates the slots of packets that the given packet overwrites, except the slot the packet is written to
+		void invalidateOverlappedTags(StreamData& data, int64 packet, int frameCount);
+
+		// Checks if the packet slot of the ring holds the given packet
+		bool isPacketValid(const StreamData& data, int64 packet, int frameCount) const;
+
+		// Copies frames of a stream to the given channels, frames of packets that were not received are concealed or silent without concealer
+		void fetchFrames(const StreamData& data, int64 time, int count, float* const* channels, int channelCount, VBANConcealer* concealer) const;
+
+		// Copies frames of a stream to the given channels, in at most two segments split where the circular buffer wraps
+		void copyFrames(const StreamData& data, int64 time, int count, float* const* channels, int channelCount) const;
+
+		// Copies the packet counters of the stream in the slot, with the overtakes and resets of its timeline since it was added
+		void getReceiveStatistics(const StreamSlot& slot, VBANReceiveStatistics::Snapshot& snapshot) const;
+
+		// Finds the stream by the key it was added with, nullptr when not found.
+		static const StreamSlot* findExactStream(const StreamRegistry& registry, const VBANStreamKey& key);
+
+		// Finds the stream for a packet key, trying the exact sender endpoint, the sender address and any sender in that order.
+		static const StreamSlot* findStream(const StreamRegistry& registry, const VBANStreamKey& key);
+
+		int mSize = 8192;								// Size of the circular buffer in samples, a power of two.
+		int mMask = 8191;								// Wraps a position into the circular buffer, mSize - 1.
+		EVBANBufferLayout mLayout = EVBANBufferLayout::Planar;
+		std::unique_ptr<Timeline[]> mTimelines;			// One timeline for every stream slot, indexed by StreamSlot::mTimeline
+		std::atomic<int> mLatencyInBuffers = 2;
+		std::atomic<int64> mUnderrunCount = { 0 };		// Underruns of all timelines
+
+		// Adaptive latency, the bounds are set from the control thread and the estimate is kept per timeline by the audio thread.
+		// The fill level of the ring is highest for audio that arrived on time, its spread is how much later than that audio arrives.
+		std::atomic<bool> mAdaptiveLatency = { false };
+		audio::DirtyFlag mAdaptiveLatencyChanged;		// Set when adaptive latency is configured, restarts the estimate
+		std::atomic<float> mMinLatency = { 0.f };		// Milliseconds
+		std::atomic<float> mMaxLatency = { 0.f };		// Milliseconds
+
+		// Drift compensation, a PI controller per timeline steers the read rate with the fill level of audio that arrived on time.
+		// Every audio callback reads frames at a fractional position, the read position followed by the phase.
+		std::atomic<bool> mDriftCompensation = { false };
+		audio::DirtyFlag mDriftCompensationChanged;		// Set when drift compensation is configured, restarts the controller
+
+		audio::DirtyFlag mResetReadPosition;			// This flag is set when the read position of every timeline has to be recalculated from its write position.
 		std::atomic<int> mStreamCount = { 0 };			// Number of streams in the circular buffer.
+		std::atomic<int64> mReadContentionCount = { 0 };	// Number of reads that overlapped with a write of the same stream.
+		std::atomic<int64> mWriteContentionCount = { 0 };	// Number of packets that waited for another writer of the stream.
 
-		// For error reporting
-		std::string mErrorMessage;
-		mutable std::mutex mErrorMessageMutex;
+		// For error reporting, without locking or allocating on the receiving and audio threads
+		VBANEventQueue mEvents = { "VBANCircularBuffer" };	// Events of the receiving and audio threads, logged on the main thread
+		std::atomic<int> mError = { -1 };				// EVBANEvent of the last packet that could not be written, -1 when it was written
+		std::atomic<int64> mErrorValue = { 0 };			// Value of the error event
 	};
 
 
@@ -147,13 +482,14 @@ namespace nap
 		VBANCircularBufferReader(audio::NodeManager& manager) : audio::Node(manager) { }
 
 		/**
-		 * Initializes the node, call after construction.
+		 * Initializes the node, call after construction and after the stream was added to the circular buffer.
 		 * @param circularBuffer Pointer to the VBANCircularBuffer it reads from.
 		 * @param streamName Name of the stream it reads from.
 		 * @param channelCount Number of channels this node reads and outputs.
 		 *	This number has to be equal for the number of channels in the stream in order to read.
+		 * @param allowedSources The allowed sources the stream was added with.
 		 */
-		void init(const audio::SafePtr<VBANCircularBuffer>& circularBuffer, const std::string& streamName, int channelCount);
+		void init(const audio::SafePtr<VBANCircularBuffer>& circularBuffer, const std::string& streamName, int channelCount, const std::vector<VBANEndpoint>& allowedSources = {});
 
 		/**
 		 * Sets number of channels this node reads and outputs.
@@ -167,6 +503,18 @@ namespace nap
 		 */
 		int getChannelCount() const { return mOutputPins.size(); }
 
+		/**
+		 * Sets how the audio of lost packets or packets that arrived too late is replaced.
+		 * @param concealment The concealment strategy
+		 */
+		void setConcealment(EVBANConcealment concealment);
+
+		/**
+		 * Sets the accuracy of the resampler that converts the sample rate of the stream and compensates drift.
+		 * @param quality The quality of the resampler
+		 */
+		void setResamplerQuality(EVBANResamplerQuality quality);
+
 		/**
 		 * @return The output pin for a certain channel.
 		 */
@@ -175,10 +523,18 @@ namespace nap
 	private:
 		// Inherited from Node
 		void process() override;
+		void sampleRateChanged(float sampleRate) override { reserveResampler(); }
+		void bufferSizeChanged(int bufferSize) override { reserveResampler(); }
+
+		// Switches the resampler to the tables of the sample rate and sizes its buffers for the channel count and buffer size, so reading never allocates
+		void reserveResampler();
 
 		audio::SafePtr<VBANCircularBuffer> mCircularBuffer;
-		std::string mStreamName;
+		VBANCircularBuffer::StreamHandle mStreamHandle;
 		std::vector<std::unique_ptr<audio::OutputPin>> mOutputPins;
+		std::vector<audio::SampleBuffer*> mOutputBuffers;	// Output buffer of every pin, gathered every process call
+		VBANResampler mResampler;							// Interpolates the stream while the circular buffer compensates clock drift
+		VBANConcealer mConcealer;							// Replaces the audio of missing packets
 	};
 
 }
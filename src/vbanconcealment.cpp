@@ -0,0 +1,275 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vbanconcealment.h"
+
+#include <rtti/typeinfo.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+RTTI_BEGIN_ENUM(nap::EVBANConcealment)
+	RTTI_ENUM_VALUE(nap::EVBANConcealment::Silence,		"Silence"),
+	RTTI_ENUM_VALUE(nap::EVBANConcealment::Repeat,		"Repeat"),
+	RTTI_ENUM_VALUE(nap::EVBANConcealment::Extrapolate,	"Extrapolate")
+RTTI_END_ENUM
+
+namespace nap
+{
+
+	static constexpr int64 sHistoryMask = VBANConcealer::sHistoryFrameCount - 1;
+
+	// Factor the mix is decimated by for the coarse period search
+	static constexpr int sDecimation = 4;
+
+	// Number of peaks of the coarse search that are refined
+	static constexpr int sCandidateCount = 8;
+
+	// Number of full rate periods around a coarse period that are compared, on both sides
+	static constexpr int sRefineRadius = sDecimation;
+
+
+	// Compares the most recent frames with the frames one period earlier for every period in the range, normalized by the energy of the earlier frames.
+	// Writes the score of period minPeriod + i to scores[i], 0 for periods that don't correlate.
+	static void scorePeriods(const float* recent, int matchFrameCount, int minPeriod, int maxPeriod, double* scores)
+	{
+		double energy = 0.0;
+		for (auto frame = 0; frame < matchFrameCount; ++frame)
+			energy += recent[frame - minPeriod] * recent[frame - minPeriod];
+
+		for (auto period = minPeriod; period <= maxPeriod; ++period)
+		{
+			const float* earlier = recent - period;
+			double correlation = 0.0;
+			for (auto frame = 0; frame < matchFrameCount; ++frame)
+				correlation += recent[frame] * earlier[frame];
+			scores[period - minPeriod] = correlation > 0.0 ? correlation / std::sqrt(energy + 1e-9) : 0.0;
+
+			// Slide the energy window one frame back
+			if (period < maxPeriod)
+				energy = std::max(0.0, energy + earlier[-1] * earlier[-1] - earlier[matchFrameCount - 1] * earlier[matchFrameCount - 1]);
+		}
+	}
+
+
+	void VBANConcealer::setMode(EVBANConcealment mode)
+	{
+		mMode = mode;
+		restart(mEnd);
+	}
+
+
+	void VBANConcealer::setChannelCount(int channelCount)
+	{
+		mChannelCount = channelCount;
+		mSource.assign(channelCount, std::vector<float>(sHistoryFrameCount, 0.f));
+		mOutput.assign(channelCount, std::vector<float>(sHistoryFrameCount, 0.f));
+		mLastFrame.assign(channelCount, 0.f);
+		mMix.resize(sMaxPeriod + sMatchFrameCount);
+		mDecimatedMix.resize(mMix.size() / sDecimation);
+		restart(mEnd);
+	}
+
+
+	void VBANConcealer::restart(int64 time)
+	{
+		mStart = time;
+		mEnd = time;
+		mConcealStart = -1;
+		mResumeStart = -1;
+		mFadeStart = -1;
+		mPeriod = 0;
+	}
+
+
+	void VBANConcealer::process(int64 time, int frameCount, bool received, float* const* channels, int channelCount)
+	{
+		channelCount = std::min(channelCount, mChannelCount);
+		if (channelCount == 0 || frameCount <= 0)
+			return;
+
+		// Start over when the run doesn't connect to the history, after the read position was reset
+		if (time > mEnd || time < std::max(mStart, mEnd - sHistoryFrameCount / 2))
+			restart(time);
+
+		// Frames that were output before are output again
+		const int repeated = static_cast<int>(std::min<int64>(mEnd - time, frameCount));
+		for (auto channel = 0; channel < channelCount; ++channel)
+		{
+			const auto& output = mOutput[channel];
+			for (auto frame = 0; frame < repeated; ++frame)
+				channels[channel][frame] = output[(time + frame) & sHistoryMask];
+		}
+		if (repeated == frameCount)
+			return;
+
+		const int64 begin = time + repeated;
+		const int64 end = time + frameCount;
+		if (received)
+		{
+			if (mConcealStart >= 0 && mResumeStart < 0)
+				mResumeStart = begin;
+
+			for (auto channel = 0; channel < channelCount; ++channel)
+			{
+				float* samples = channels[channel] + repeated;
+				auto& source = mSource[channel];
+				auto& output = mOutput[channel];
+				for (auto t = begin; t < end; ++t)
+				{
+					float sample = samples[t - begin];
+
+					// Crossfade from the concealed audio to the received audio, also in the history so it stays continuous
+					if (mResumeStart >= 0 && t - mResumeStart < sCrossfadeFrameCount)
+					{
+						const float weight = static_cast<float>(t - mResumeStart + 1) / (sCrossfadeFrameCount + 1);
+						const float concealed = getConcealedFrame(channel, t);
+						const float gained = concealed * getGain(t);
+						source[t & sHistoryMask] = concealed + (sample - concealed) * weight;
+						sample = gained + (sample - gained) * weight;
+						samples[t - begin] = sample;
+					}
+					else {
+						source[t & sHistoryMask] = sample;
+					}
+					output[t & sHistoryMask] = sample;
+				}
+			}
+
+			if (mResumeStart >= 0 && end - mResumeStart >= sCrossfadeFrameCount)
+			{
+				mConcealStart = -1;
+				mResumeStart = -1;
+			}
+		}
+		else
+		{
+			// Start concealing from the last frame, also when frames go missing again while crossfading back.
+			// The fade out continues when concealment restarts while crossfading back.
+			if (mConcealStart < 0 || mResumeStart >= 0)
+			{
+				mPeriod = findPeriod(channelCount);
+				for (auto channel = 0; channel < channelCount; ++channel)
+					mLastFrame[channel] = begin > mStart ? mSource[channel][(begin - 1) & sHistoryMask] : 0.f;
+				if (mConcealStart < 0)
+					mFadeStart = begin;
+				mConcealStart = begin;
+				mResumeStart = -1;
+			}
+
+			for (auto channel = 0; channel < channelCount; ++channel)
+			{
+				float* samples = channels[channel] + repeated;
+				auto& source = mSource[channel];
+				auto& output = mOutput[channel];
+				for (auto t = begin; t < end; ++t)
+				{
+					const float concealed = getConcealedFrame(channel, t);
+					const float sample = concealed * getGain(t);
+					source[t & sHistoryMask] = concealed;
+					output[t & sHistoryMask] = sample;
+					samples[t - begin] = sample;
+				}
+			}
+		}
+
+		mEnd = end;
+		mStart = std::max(mStart, mEnd - sHistoryFrameCount);
+	}
+
+
+	float VBANConcealer::getConcealedFrame(int channel, int64 time) const
+	{
+		// Crossfade from the last frame to the periodic continuation of the history
+		const float fade_in = std::min(1.f, static_cast<float>(time - mConcealStart + 1) / (sCrossfadeFrameCount + 1));
+		const float last = mLastFrame[channel];
+		const float continuation = mPeriod > 0 ? mSource[channel][(time - mPeriod) & sHistoryMask] : 0.f;
+		return last + (continuation - last) * fade_in;
+	}
+
+
+	float VBANConcealer::getGain(int64 time) const
+	{
+		// Hold and fade out to silence
+		const int64 index = time - mFadeStart;
+		return index < sHoldFrameCount ? 1.f : std::max(0.f, 1.f - static_cast<float>(index - sHoldFrameCount) / sFadeFrameCount);
+	}
+
+
+	int VBANConcealer::findPeriod(int channelCount)
+	{
+		const int64 history = mEnd - mStart;
+		if (mMode == EVBANConcealment::Repeat)
+			return history >= sRepeatFrameCount ? sRepeatFrameCount : 0;
+
+		// Mix the channels down, so every period is compared once
+		const int mix_count = sMaxPeriod + sMatchFrameCount;
+		if (history < mix_count)
+			return 0;
+		const int64 first = mEnd - mix_count;
+		std::fill(mMix.begin(), mMix.end(), 0.f);
+		for (auto channel = 0; channel < channelCount; ++channel)
+		{
+			const auto& source = mSource[channel];
+			for (auto frame = 0; frame < mix_count; ++frame)
+				mMix[frame] += source[(first + frame) & sHistoryMask];
+		}
+
+		// Search all periods on the decimated mix first, which takes sDecimation squared fewer multiplications than searching the full mix
+		for (auto frame = 0; frame < static_cast<int>(mDecimatedMix.size()); ++frame)
+		{
+			const float* block = mMix.data() + frame * sDecimation;
+			float sum = 0.f;
+			for (auto offset = 0; offset < sDecimation; ++offset)
+				sum += block[offset];
+			mDecimatedMix[frame] = sum;
+		}
+		const int coarse_min_period = sMinPeriod / sDecimation;
+		const int coarse_period_count = sMaxPeriod / sDecimation - coarse_min_period + 1;
+		std::array<double, sMaxPeriod / sDecimation + 1> scores;
+		scorePeriods(mDecimatedMix.data() + sMaxPeriod / sDecimation, sMatchFrameCount / sDecimation, coarse_min_period, sMaxPeriod / sDecimation, scores.data());
+
+		// Keep the highest peaks, multiples of the period score alike on the decimated mix but differ at the full rate
+		std::array<int, sCandidateCount> candidates;
+		std::array<double, sCandidateCount> candidate_scores;
+		candidates.fill(0);
+		candidate_scores.fill(0.0);
+		for (auto index = 0; index < coarse_period_count; ++index)
+		{
+			double score = scores[index];
+			if ((index > 0 && scores[index - 1] >= score) || (index + 1 < coarse_period_count && scores[index + 1] > score))
+				continue;
+			int period = (coarse_min_period + index) * sDecimation;
+			for (auto candidate = 0; candidate < sCandidateCount && score > 0.0; ++candidate)
+			{
+				if (score > candidate_scores[candidate])
+				{
+					std::swap(score, candidate_scores[candidate]);
+					std::swap(period, candidates[candidate]);
+				}
+			}
+		}
+
+		// Then refine the peaks on the full mix
+		int best_period = sMaxPeriod;
+		double best_score = 0.0;
+		for (auto candidate = 0; candidate < sCandidateCount && candidate_scores[candidate] > 0.0; ++candidate)
+		{
+			const int min_period = std::max(sMinPeriod, candidates[candidate] - sRefineRadius);
+			const int max_period = std::min(sMaxPeriod, candidates[candidate] + sRefineRadius);
+			scorePeriods(mMix.data() + sMaxPeriod, sMatchFrameCount, min_period, max_period, scores.data());
+			for (auto period = min_period; period <= max_period; ++period)
+			{
+				if (scores[period - min_period] > best_score)
+				{
+					best_score = scores[period - min_period];
+					best_period = period;
+				}
+			}
+		}
+		return best_period;
+	}
+
+}
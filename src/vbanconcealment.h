@@ -0,0 +1,105 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <vector>
+
+// Nap includes
+#include <utility/dllexport.h>
+#include <nap/numeric.h>
+
+namespace nap
+{
+
+	/**
+	 * How audio of packets that were lost or arrived too late is replaced.
+	 */
+	enum class EVBANConcealment : int
+	{
+		Silence		= 0,	///< Output silence, the cheapest but a hard click at high levels
+		Repeat		= 1,	///< Repeat the last received block of audio, crossfaded in and out
+		Extrapolate	= 2		///< Continue the waveform from the period that is most similar to the last received audio, crossfaded in and out
+	};
+
+
+	/**
+	 * Replaces frames of lost packets with audio derived from the frames received before them.
+	 * Frames are passed in order of time, in runs of received or missing frames. The concealer keeps a history of the frames it passed,
+	 * missing frames continue that history periodically, with a period chosen by the strategy. Concealed frames are part of the history.
+	 * Concealed audio is faded in from the last frame, held for sHoldFrameCount frames and then faded out, so a long outage ends in silence.
+	 * When frames are received again they are crossfaded with the concealed audio over sCrossfadeFrameCount frames.
+	 * Runs that overlap frames passed before are output as they were the first time, so overlapping reads agree.
+	 * Not thread-safe, use one concealer per reader.
+	 */
+	class NAPAPI VBANConcealer final
+	{
+	public:
+		static constexpr int sHistoryFrameCount = 2048;		///< Number of frames kept per channel, a power of two
+		static constexpr int sCrossfadeFrameCount = 64;		///< Length of the fades at both ends of a concealed run
+		static constexpr int sHoldFrameCount = 1024;		///< Number of concealed frames output at full level
+		static constexpr int sFadeFrameCount = 1024;		///< Number of frames concealment fades out over after the hold
+		static constexpr int sRepeatFrameCount = 256;		///< Number of frames repeated by EVBANConcealment::Repeat
+		static constexpr int sMinPeriod = 32;				///< Shortest period EVBANConcealment::Extrapolate searches
+		static constexpr int sMaxPeriod = 1024;				///< Longest period EVBANConcealment::Extrapolate searches
+		static constexpr int sMatchFrameCount = 256;		///< Number of recent frames EVBANConcealment::Extrapolate compares with every period
+
+		/**
+		 * @param mode the concealment strategy, restarts the history
+		 */
+		void setMode(EVBANConcealment mode);
+
+		/**
+		 * @return the concealment strategy
+		 */
+		EVBANConcealment getMode() const { return mMode; }
+
+		/**
+		 * Allocates the history of every channel, restarts the history.
+		 * @param channelCount maximum number of channels that is concealed
+		 */
+		void setChannelCount(int channelCount);
+
+		/**
+		 * Passes a run of frames that were either all received or all missing.
+		 * Runs that don't connect to the history restart it, missing frames without history are silent.
+		 * @param time position of the first frame in the stream
+		 * @param frameCount number of frames in the run
+		 * @param received true when the channels hold received frames, false when the frames are missing and have to be concealed
+		 * @param channels frames of every channel, replaced by the output
+		 * @param channelCount number of channels, channels beyond the allocated channel count are not touched
+		 */
+		void process(int64 time, int frameCount, bool received, float* const* channels, int channelCount);
+
+	private:
+		// Restarts the history at the given time
+		void restart(int64 time);
+
+		// Chooses the period to continue the history with at the end of the history, 0 when there is not enough history.
+		// Searches a decimated mix of the channels and refines the best period at the full rate, so concealment can start within an audio callback.
+		int findPeriod(int channelCount);
+
+		// Concealed frame of a channel at the given time, before the fade out
+		float getConcealedFrame(int channel, int64 time) const;
+
+		// Gain of the fade out at the given time
+		float getGain(int64 time) const;
+
+		EVBANConcealment mMode = EVBANConcealment::Silence;
+		int mChannelCount = 0;
+		std::vector<std::vector<float>> mSource;	// Received frames and their periodic continuation of every channel
+		std::vector<std::vector<float>> mOutput;	// Output frames of every channel
+		std::vector<float> mLastFrame;				// Last frame of every channel in the history before concealment started
+		std::vector<float> mMix;					// Channels mixed down to compare periods
+		std::vector<float> mDecimatedMix;			// Mix decimated for the coarse period search
+		int64 mStart = 0;							// Time of the oldest frame of the history
+		int64 mEnd = 0;								// Time after the newest frame of the history
+		int64 mConcealStart = -1;					// Time of the first concealed frame, -1 when not concealing
+		int64 mResumeStart = -1;					// Time of the first frame received after concealment, -1 when not crossfading
+		int64 mFadeStart = -1;						// Time the fade out is relative to, the start of the first of consecutive concealed runs
+		int mPeriod = 0;							// Period the history is continued with, 0 for silence
+	};
+
+}
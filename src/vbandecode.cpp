@@ -0,0 +1,305 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vbandecode.h"
+
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define VBAN_DECODE_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define VBAN_TARGET_AVX2
+	#else
+		#define VBAN_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#elif (defined(__ARM_NEON) || defined(_M_ARM64)) && (!defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	#define VBAN_DECODE_NEON
+	#include <arm_neon.h>
+#endif
+
+namespace nap
+{
+
+	// Samples are scaled by multiplying with the reciprocal of the largest positive value, for all kernels alike
+	static constexpr float sInt16Scale = 1.f / static_cast<float>(std::numeric_limits<int16_t>::max());
+	static constexpr float sInt24Scale = 1.f / 8388607.f;
+	static constexpr float sInt32Scale = 1.f / static_cast<float>(std::numeric_limits<int32_t>::max());
+
+
+	void utility::convertVBANInt16Reference(const uint8_t* source, int sampleCount, float* destination)
+	{
+		for (auto i = 0; i < sampleCount; ++i)
+		{
+			auto value = static_cast<int16_t>(static_cast<uint16_t>(source[0]) | (static_cast<uint16_t>(source[1]) << 8));
+			destination[i] = static_cast<float>(value) * sInt16Scale;
+			source += 2;
+		}
+	}
+
+
+	void utility::convertVBANInt32Reference(const uint8_t* source, int sampleCount, float* destination)
+	{
+		for (auto i = 0; i < sampleCount; ++i)
+		{
+			auto value = static_cast<int32_t>(static_cast<uint32_t>(source[0]) | (static_cast<uint32_t>(source[1]) << 8) |
+				(static_cast<uint32_t>(source[2]) << 16) | (static_cast<uint32_t>(source[3]) << 24));
+			destination[i] = static_cast<float>(value) * sInt32Scale;
+			source += 4;
+		}
+	}
+
+
+	void utility::convertVBANInt24Reference(const uint8_t* source, int sampleCount, float* destination)
+	{
+		for (auto i = 0; i < sampleCount; ++i)
+		{
+			// Place the sample in the upper 3 bytes and shift back down arithmetically to sign extend
+			auto value = static_cast<int32_t>((static_cast<uint32_t>(source[0]) << 8) | (static_cast<uint32_t>(source[1]) << 16) |
+				(static_cast<uint32_t>(source[2]) << 24)) >> 8;
+			destination[i] = static_cast<float>(value) * sInt24Scale;
+			source += 3;
+		}
+	}
+
+
+#ifdef VBAN_DECODE_X86
+	static void convertInt16SSE2(const uint8_t* source, int sampleCount, float* destination)
+	{
+		const __m128 scale = _mm_set1_ps(sInt16Scale);
+		int i = 0;
+		for (; i + 8 <= sampleCount; i += 8)
+		{
+			// Sign extend by duplicating every sample into the upper half and shifting it back down arithmetically
+			__m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2));
+			__m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+			__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+			_mm_storeu_ps(destination + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+			_mm_storeu_ps(destination + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+		}
+		utility::convertVBANInt16Reference(source + i * 2, sampleCount - i, destination + i);
+	}
+
+
+	static void convertInt32SSE2(const uint8_t* source, int sampleCount, float* destination)
+	{
+		const __m128 scale = _mm_set1_ps(sInt32Scale);
+		int i = 0;
+		for (; i + 4 <= sampleCount; i += 4)
+		{
+			__m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+			_mm_storeu_ps(destination + i, _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+		}
+		utility::convertVBANInt32Reference(source + i * 4, sampleCount - i, destination + i);
+	}
+
+
+	VBAN_TARGET_AVX2 static void convertInt16AVX2(const uint8_t* source, int sampleCount, float* destination)
+	{
+		const __m256 scale = _mm256_set1_ps(sInt16Scale);
+		int i = 0;
+		for (; i + 8 <= sampleCount; i += 8)
+		{
+			__m256i samples = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2)));
+			_mm256_storeu_ps(destination + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+		}
+		utility::convertVBANInt16Reference(source + i * 2, sampleCount - i, destination + i);
+	}
+
+
+	VBAN_TARGET_AVX2 static void convertInt32AVX2(const uint8_t* source, int sampleCount, float* destination)
+	{
+		const __m256 scale = _mm256_set1_ps(sInt32Scale);
+		int i = 0;
+		for (; i + 8 <= sampleCount; i += 8)
+		{
+			__m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 4));
+			_mm256_storeu_ps(destination + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+		}
+		utility::convertVBANInt32Reference(source + i * 4, sampleCount - i, destination + i);
+	}
+
+
+	VBAN_TARGET_AVX2 static void convertInt24AVX2(const uint8_t* source, int sampleCount, float* destination)
+	{
+		// Moves the 12 bytes of samples 4 to 7 into the upper lane, the byte shuffle can't cross lanes
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+
+		// Places the 3 bytes of every sample in the upper 3 bytes of a 32 bit integer, the lowest byte is zeroed
+		const __m256i bytes = _mm256_setr_epi8(
+			-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+			-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+		const __m256 scale = _mm256_set1_ps(sInt24Scale);
+
+		// Every iteration loads 32 bytes of which 24 are used, stop while the full load stays within the samples
+		int i = 0;
+		for (; i * 3 + 32 <= sampleCount * 3; i += 8)
+		{
+			__m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 3));
+			samples = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(samples, lanes), bytes);
+			samples = _mm256_srai_epi32(samples, 8);
+			_mm256_storeu_ps(destination + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+		}
+		utility::convertVBANInt24Reference(source + i * 3, sampleCount - i, destination + i);
+	}
+
+
+	static bool supportsAVX2()
+	{
+	#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// AVX2 needs the OS to save the upper halves of the vector registers
+		__cpuid(info, 1);
+		const bool os_saves_avx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+		__cpuidex(info, 7, 0);
+		return os_saves_avx && (info[1] & (1 << 5)) != 0;
+	#else
+		return __builtin_cpu_supports("avx2");
+	#endif
+	}
+#endif // VBAN_DECODE_X86
+
+
+#ifdef VBAN_DECODE_NEON
+	static void convertInt16NEON(const uint8_t* source, int sampleCount, float* destination)
+	{
+		int i = 0;
+		for (; i + 8 <= sampleCount; i += 8)
+		{
+			int16x8_t samples = vld1q_s16(reinterpret_cast<const int16_t*>(source + i * 2));
+			vst1q_f32(destination + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))), sInt16Scale));
+			vst1q_f32(destination + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), sInt16Scale));
+		}
+		utility::convertVBANInt16Reference(source + i * 2, sampleCount - i, destination + i);
+	}
+
+
+	static void convertInt32NEON(const uint8_t* source, int sampleCount, float* destination)
+	{
+		int i = 0;
+		for (; i + 4 <= sampleCount; i += 4)
+		{
+			int32x4_t samples = vld1q_s32(reinterpret_cast<const int32_t*>(source + i * 4));
+			vst1q_f32(destination + i, vmulq_n_f32(vcvtq_f32_s32(samples), sInt32Scale));
+		}
+		utility::convertVBANInt32Reference(source + i * 4, sampleCount - i, destination + i);
+	}
+#endif // VBAN_DECODE_NEON
+
+
+	std::vector<utility::VBANDecodeKernels> utility::getSupportedVBANDecodeKernels()
+	{
+		std::vector<VBANDecodeKernels> kernels(1);
+#if defined(VBAN_DECODE_X86)
+		kernels.push_back({ &convertInt16SSE2, &convertVBANInt24Reference, &convertInt32SSE2, "SSE2" });
+		if (supportsAVX2())
+			kernels.push_back({ &convertInt16AVX2, &convertInt24AVX2, &convertInt32AVX2, "AVX2" });
+#elif defined(VBAN_DECODE_NEON)
+		kernels.push_back({ &convertInt16NEON, &convertVBANInt24Reference, &convertInt32NEON, "NEON" });
+#endif
+		return kernels;
+	}
+
+
+	// Conversion kernels for the CPU the process runs on, selected once on first use
+	static const utility::VBANDecodeKernels& getKernels()
+	{
+		static const utility::VBANDecodeKernels kernels = utility::getSupportedVBANDecodeKernels().back();
+		return kernels;
+	}
+
+
+	void utility::convertVBANInt16(const uint8_t* source, int sampleCount, float* destination)
+	{
+		getKernels().mConvertInt16(source, sampleCount, destination);
+	}
+
+
+	void utility::convertVBANInt32(const uint8_t* source, int sampleCount, float* destination)
+	{
+		getKernels().mConvertInt32(source, sampleCount, destination);
+	}
+
+
+	void utility::convertVBANInt24(const uint8_t* source, int sampleCount, float* destination)
+	{
+		getKernels().mConvertInt24(source, sampleCount, destination);
+	}
+
+
+	void utility::convertVBANFloat32(const uint8_t* source, int sampleCount, float* destination)
+	{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		for (auto i = 0; i < sampleCount; ++i)
+		{
+			uint32_t value = static_cast<uint32_t>(source[0]) | (static_cast<uint32_t>(source[1]) << 8) |
+				(static_cast<uint32_t>(source[2]) << 16) | (static_cast<uint32_t>(source[3]) << 24);
+			std::memcpy(destination + i, &value, sizeof(float));
+			source += 4;
+		}
+#else
+		std::memcpy(destination, source, sampleCount * sizeof(float));
+#endif
+	}
+
+
+	void utility::deinterleaveVBANFrames(const float* source, int frameCount, int channelCount, int frameSize, float* const* channels)
+	{
+		if (channelCount == 1 && frameSize == 1)
+		{
+			std::memcpy(channels[0], source, frameCount * sizeof(float));
+			return;
+		}
+
+		// Stereo frames, the most common layout, are split 4 frames at a time
+		int first_frame = 0;
+#if defined(VBAN_DECODE_X86)
+		if (channelCount == 2 && frameSize == 2)
+		{
+			for (; first_frame + 4 <= frameCount; first_frame += 4)
+			{
+				const __m128 low = _mm_loadu_ps(source + first_frame * 2);
+				const __m128 high = _mm_loadu_ps(source + first_frame * 2 + 4);
+				_mm_storeu_ps(channels[0] + first_frame, _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_storeu_ps(channels[1] + first_frame, _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+			}
+		}
+#elif defined(VBAN_DECODE_NEON)
+		if (channelCount == 2 && frameSize == 2)
+		{
+			for (; first_frame + 4 <= frameCount; first_frame += 4)
+			{
+				const float32x4x2_t frames = vld2q_f32(source + first_frame * 2);
+				vst1q_f32(channels[0] + first_frame, frames.val[0]);
+				vst1q_f32(channels[1] + first_frame, frames.val[1]);
+			}
+		}
+#endif
+
+		// Channel by channel, so every destination plane is written sequentially
+		for (auto channel = 0; channel < channelCount; ++channel)
+		{
+			const float* sample = source + first_frame * frameSize + channel;
+			float* destination = channels[channel];
+			for (auto frame = first_frame; frame < frameCount; ++frame)
+			{
+				destination[frame] = *sample;
+				sample += frameSize;
+			}
+		}
+	}
+
+
+	const char* utility::getVBANDecodeInstructionSet()
+	{
+		return getKernels().mInstructionSet;
+	}
+
+}
@@ -0,0 +1,118 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <utility/dllexport.h>
+#include "vban/vban.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace nap
+{
+	namespace utility
+	{
+		/**
+		 * Maximum number of samples in a VBAN audio packet, reached with 16 bit samples.
+		 */
+		constexpr int VBAN_MAX_PACKET_SAMPLE_COUNT = (VBAN_PROTOCOL_MAX_SIZE - VBAN_HEADER_SIZE) / 2;
+
+		/**
+		 * Maximum number of channels in a VBAN stream, the header stores the channel count minus one in a byte.
+		 */
+		constexpr int VBAN_MAX_CHANNEL_COUNT = 256;
+
+		/**
+		 * Maximum number of frames in a VBAN packet, the header stores the frame count minus one in a byte.
+		 */
+		constexpr int VBAN_MAX_PACKET_FRAME_COUNT = 256;
+
+		/**
+		 * Converts little endian 16 bit PCM samples to floats between -1 and 1.
+		 * Uses the widest vector instructions the CPU supports, the result is bit exact with convertVBANInt16Reference().
+		 * @param source PCM samples as received, not necessarily aligned
+		 * @param sampleCount number of samples to convert
+		 * @param destination receives the converted samples
+		 */
+		void NAPAPI convertVBANInt16(const uint8_t* source, int sampleCount, float* destination);
+
+		/**
+		 * Converts little endian 32 bit PCM samples to floats between -1 and 1.
+		 * Uses the widest vector instructions the CPU supports, the result is bit exact with convertVBANInt32Reference().
+		 * @param source PCM samples as received, not necessarily aligned
+		 * @param sampleCount number of samples to convert
+		 * @param destination receives the converted samples
+		 */
+		void NAPAPI convertVBANInt32(const uint8_t* source, int sampleCount, float* destination);
+
+		/**
+		 * Converts little endian 24 bit PCM samples, packed in 3 bytes each, to floats between -1 and 1.
+		 * Uses AVX2 when the CPU supports it, the result is bit exact with convertVBANInt24Reference().
+		 * @param source PCM samples as received
+		 * @param sampleCount number of samples to convert
+		 * @param destination receives the converted samples
+		 */
+		void NAPAPI convertVBANInt24(const uint8_t* source, int sampleCount, float* destination);
+
+		/**
+		 * Copies little endian 32 bit float samples, the samples are not scaled.
+		 * @param source float samples as received, not necessarily aligned
+		 * @param sampleCount number of samples to copy
+		 * @param destination receives the samples
+		 */
+		void NAPAPI convertVBANFloat32(const uint8_t* source, int sampleCount, float* destination);
+
+		/**
+		 * Scalar reference implementation of convertVBANInt16(), used to verify the vectorized kernels.
+		 */
+		void NAPAPI convertVBANInt16Reference(const uint8_t* source, int sampleCount, float* destination);
+
+		/**
+		 * Scalar reference implementation of convertVBANInt24(), used to verify the vectorized kernels.
+		 */
+		void NAPAPI convertVBANInt24Reference(const uint8_t* source, int sampleCount, float* destination);
+
+		/**
+		 * Scalar reference implementation of convertVBANInt32(), used to verify the vectorized kernels.
+		 */
+		void NAPAPI convertVBANInt32Reference(const uint8_t* source, int sampleCount, float* destination);
+
+		/**
+		 * Splits interleaved frames into one plane per channel.
+		 * Stereo frames are split with vector instructions, other layouts channel by channel.
+		 * @param source interleaved samples, frameCount * frameSize in total
+		 * @param frameCount number of frames
+		 * @param channelCount number of channels to split off, the first channels of every frame
+		 * @param frameSize number of samples per frame, at least channelCount
+		 * @param channels destination of every channel, each receives frameCount samples
+		 */
+		void NAPAPI deinterleaveVBANFrames(const float* source, int frameCount, int channelCount, int frameSize, float* const* channels);
+
+		/**
+		 * Conversion kernels of a single instruction set.
+		 */
+		struct VBANDecodeKernels
+		{
+			using ConvertFunction = void (*)(const uint8_t* source, int sampleCount, float* destination);
+
+			ConvertFunction mConvertInt16 = &convertVBANInt16Reference;
+			ConvertFunction mConvertInt24 = &convertVBANInt24Reference;
+			ConvertFunction mConvertInt32 = &convertVBANInt32Reference;
+			const char* mInstructionSet = "Scalar";
+		};
+
+		/**
+		 * Returns the kernels of every instruction set this CPU supports, the scalar reference first and the kernels that are used last.
+		 * Allows verifying every kernel against the reference, not only the one selected for this CPU.
+		 * @return The supported kernels
+		 */
+		std::vector<VBANDecodeKernels> NAPAPI getSupportedVBANDecodeKernels();
+
+		/**
+		 * @return The name of the instruction set the conversion kernels were selected for on this CPU: "AVX2", "SSE2", "NEON" or "Scalar".
+		 */
+		NAPAPI const char* getVBANDecodeInstructionSet();
+	}
+}
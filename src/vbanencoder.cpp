@@ -0,0 +1,138 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vbanencoder.h"
+
+#include <rtti/typeinfo.h>
+
+#include <cmath>
+
+RTTI_BEGIN_ENUM(nap::EVBANSampleFormat)
+	RTTI_ENUM_VALUE(nap::EVBANSampleFormat::Int16,		"Int16"),
+	RTTI_ENUM_VALUE(nap::EVBANSampleFormat::Int24,		"Int24"),
+	RTTI_ENUM_VALUE(nap::EVBANSampleFormat::Int32,		"Int32"),
+	RTTI_ENUM_VALUE(nap::EVBANSampleFormat::Float32,	"Float32")
+RTTI_END_ENUM
+
+namespace nap
+{
+
+	// Writes the lowest byteCount bytes of value in little endian order
+	static inline void writeLittleEndian(uint32_t value, int byteCount, uint8_t* destination)
+	{
+		for (auto i = 0; i < byteCount; ++i)
+			destination[i] = static_cast<uint8_t>(value >> (i * 8));
+	}
+
+
+	// Scales a sample to a signed integer of the given full scale, clipping samples outside of -1 and 1
+	static inline uint32_t toPCM(float sample, double fullScale)
+	{
+		const double value = std::lrint(std::clamp(static_cast<double>(sample), -1.0, 1.0) * fullScale);
+		return static_cast<uint32_t>(static_cast<int32_t>(value));
+	}
+
+
+	uint8_t utility::getVBANBitFormat(EVBANSampleFormat format)
+	{
+		switch (format)
+		{
+		case EVBANSampleFormat::Int24:
+			return VBAN_BITFMT_24_INT;
+		case EVBANSampleFormat::Int32:
+			return VBAN_BITFMT_32_INT;
+		case EVBANSampleFormat::Float32:
+			return VBAN_BITFMT_32_FLOAT;
+		default:
+			return VBAN_BITFMT_16_INT;
+		}
+	}
+
+
+	int utility::getVBANSampleSize(EVBANSampleFormat format)
+	{
+		switch (format)
+		{
+		case EVBANSampleFormat::Int24:
+			return 3;
+		case EVBANSampleFormat::Int32:
+		case EVBANSampleFormat::Float32:
+			return 4;
+		default:
+			return 2;
+		}
+	}
+
+
+	// Interleaves the frames of every channel, the sample format is selected once by the sample writer
+	template<int SampleSize, typename WriteSample>
+	static inline void encodeFrames(const float* const* channels, int channelCount, int offset, int frameCount, uint8_t* destination, WriteSample writeSample)
+	{
+		const int frame_size = channelCount * SampleSize;
+
+		// Channel by channel, so every source channel is read sequentially
+		for (auto channel = 0; channel < channelCount; ++channel)
+		{
+			const float* source = channels[channel] + offset;
+			uint8_t* sample = destination + channel * SampleSize;
+			for (auto frame = 0; frame < frameCount; ++frame)
+			{
+				writeSample(source[frame], sample);
+				sample += frame_size;
+			}
+		}
+	}
+
+
+	static void encodeInt16(const float* const* channels, int channelCount, int offset, int frameCount, uint8_t* destination)
+	{
+		encodeFrames<2>(channels, channelCount, offset, frameCount, destination, [](float sample, uint8_t* output) { writeLittleEndian(toPCM(sample, 32767.0), 2, output); });
+	}
+
+
+	static void encodeInt24(const float* const* channels, int channelCount, int offset, int frameCount, uint8_t* destination)
+	{
+		encodeFrames<3>(channels, channelCount, offset, frameCount, destination, [](float sample, uint8_t* output) { writeLittleEndian(toPCM(sample, 8388607.0), 3, output); });
+	}
+
+
+	static void encodeInt32(const float* const* channels, int channelCount, int offset, int frameCount, uint8_t* destination)
+	{
+		encodeFrames<4>(channels, channelCount, offset, frameCount, destination, [](float sample, uint8_t* output) { writeLittleEndian(toPCM(sample, 2147483647.0), 4, output); });
+	}
+
+
+	static void encodeFloat32(const float* const* channels, int channelCount, int offset, int frameCount, uint8_t* destination)
+	{
+		encodeFrames<4>(channels, channelCount, offset, frameCount, destination, [](float sample, uint8_t* output)
+		{
+			uint32_t value;
+			std::memcpy(&value, &sample, sizeof(float));
+			writeLittleEndian(value, 4, output);
+		});
+	}
+
+
+	utility::VBANEncodeFunction utility::getVBANEncodeFunction(EVBANSampleFormat format)
+	{
+		switch (format)
+		{
+		case EVBANSampleFormat::Float32:
+			return &encodeFloat32;
+		case EVBANSampleFormat::Int32:
+			return &encodeInt32;
+		case EVBANSampleFormat::Int24:
+			return &encodeInt24;
+		default:
+			return &encodeInt16;
+		}
+	}
+
+
+	void utility::encodeVBANFrames(const float* const* channels, int channelCount, int offset, int frameCount, EVBANSampleFormat format, uint8_t* destination)
+	{
+		getVBANEncodeFunction(format)(channels, channelCount, offset, frameCount, destination);
+	}
+
+}
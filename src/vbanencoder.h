@@ -0,0 +1,205 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Vban includes
+#include <vban/vban.h>
+
+// Nap includes
+#include <utility/dllexport.h>
+
+// Local includes
+#include "vbandecode.h"
+
+namespace nap
+{
+
+	/**
+	 * Sample format of the audio in a sent VBAN stream.
+	 */
+	enum class EVBANSampleFormat : int
+	{
+		Int16		= 0,	///< 16 bit PCM, the least bandwidth
+		Int24		= 1,	///< 24 bit PCM, packed in 3 bytes
+		Int32		= 2,	///< 32 bit PCM
+		Float32		= 3		///< 32 bit float, sent without conversion and with headroom above full scale
+	};
+
+
+	namespace utility
+	{
+		/**
+		 * @param format the sample format
+		 * @return The VBAN bit resolution of the sample format, to be stored in the format_bit field of the header.
+		 */
+		uint8_t NAPAPI getVBANBitFormat(EVBANSampleFormat format);
+
+		/**
+		 * @param format the sample format
+		 * @return The size of a single sample in bytes.
+		 */
+		int NAPAPI getVBANSampleSize(EVBANSampleFormat format);
+
+		/**
+		 * Interleaves and converts frames of float samples to a single sample format, see encodeVBANFrames().
+		 */
+		using VBANEncodeFunction = void (*)(const float* const* channels, int channelCount, int offset, int frameCount, uint8_t* destination);
+
+		/**
+		 * Selects the function that encodes frames to a sample format, so the format is not checked for every sample.
+		 * @param format sample format to encode to
+		 * @return The encoding function of the sample format
+		 */
+		VBANEncodeFunction NAPAPI getVBANEncodeFunction(EVBANSampleFormat format);
+
+		/**
+		 * Interleaves and converts frames of float samples to the little endian sample format of a VBAN packet.
+		 * PCM formats are clipped at full scale, floats are copied as they are.
+		 * @param channels source samples of every channel
+		 * @param channelCount number of channels
+		 * @param offset index of the first frame to encode in the channels
+		 * @param frameCount number of frames to encode
+		 * @param format sample format to encode to
+		 * @param destination receives frameCount * channelCount samples
+		 */
+		void NAPAPI encodeVBANFrames(const float* const* channels, int channelCount, int offset, int frameCount, EVBANSampleFormat format, uint8_t* destination);
+	}
+
+
+	/**
+	 * Packs audio into VBAN packets of a selectable sample format and hands them to the sender.
+	 * The encoding function of the sample format is selected when the format is set, not for every packet or sample.
+	 * Every packet holds the same number of frames, the most that fit in a packet at the current channel count and sample format.
+	 * The packet counter restarts when the channel count or sample format changes, so receivers realign with the stream.
+	 * Not thread-safe, configure and process on the audio thread.
+	 * The sender needs a sendPacket(const std::vector<char>&) method.
+	 */
+	template<typename Sender>
+	class VBANEncoder final
+	{
+	public:
+		VBANEncoder(Sender& sender) : mSender(sender)
+		{
+			mPacket.reserve(VBAN_PROTOCOL_MAX_SIZE);
+			mPacket.resize(VBAN_HEADER_SIZE, 0);
+			std::memcpy(mPacket.data(), "VBAN", 4);
+			mChannels.reserve(utility::VBAN_MAX_CHANNEL_COUNT);
+			setSampleFormat(mSampleFormat);
+			setChannelCount(1);
+		}
+
+		/**
+		 * @param name name of the stream, truncated to 16 characters
+		 */
+		void setStreamName(const std::string& name)
+		{
+			std::memset(getHeader().streamname, 0, VBAN_STREAM_NAME_SIZE);
+			std::memcpy(getHeader().streamname, name.data(), std::min<size_t>(name.size(), VBAN_STREAM_NAME_SIZE));
+		}
+
+		/**
+		 * @param format VBAN sample rate format of the stream
+		 */
+		void setSampleRateFormat(uint8_t format)
+		{
+			getHeader().format_SR = format;
+		}
+
+		/**
+		 * @param format sample format to send
+		 */
+		void setSampleFormat(EVBANSampleFormat format)
+		{
+			mSampleFormat = format;
+			mEncode = utility::getVBANEncodeFunction(format);
+			getHeader().format_bit = utility::getVBANBitFormat(format);
+			restart();
+		}
+
+		/**
+		 * @return the sample format that is sent
+		 */
+		EVBANSampleFormat getSampleFormat() const { return mSampleFormat; }
+
+		/**
+		 * @param channelCount number of channels to send
+		 */
+		void setChannelCount(int channelCount)
+		{
+			mChannelCount = std::clamp(channelCount, 1, utility::VBAN_MAX_CHANNEL_COUNT);
+			getHeader().format_nbc = static_cast<uint8_t>(mChannelCount - 1);
+			mChannels.resize(mChannelCount);
+			restart();
+		}
+
+		/**
+		 * @return the number of channels that is sent
+		 */
+		int getChannelCount() const { return mChannelCount; }
+
+		/**
+		 * Encodes a buffer of audio, sends every packet that is completed.
+		 * Frames that don't complete a packet are kept until the next call.
+		 * @param buffer the audio, buffer[channel].data() has to return the samples of a channel
+		 * @param frameCount number of frames in the buffer
+		 */
+		template<typename Buffer>
+		void process(const Buffer& buffer, int frameCount)
+		{
+			for (auto channel = 0; channel < mChannelCount; ++channel)
+				mChannels[channel] = buffer[channel].data();
+
+			int offset = 0;
+			while (offset < frameCount)
+			{
+				const int count = std::min(frameCount - offset, mPacketFrameCount - mFrameCount);
+				mEncode(mChannels.data(), mChannelCount, offset, count, reinterpret_cast<uint8_t*>(mPacket.data()) + VBAN_HEADER_SIZE + mFrameCount * mChannelCount * mSampleSize);
+				offset += count;
+				mFrameCount += count;
+
+				if (mFrameCount == mPacketFrameCount)
+				{
+					getHeader().nuFrame = mPacketCounter++;
+					mSender.sendPacket(mPacket);
+					mFrameCount = 0;
+				}
+			}
+		}
+
+	private:
+		VBanHeader& getHeader() { return *reinterpret_cast<VBanHeader*>(mPacket.data()); }
+
+		// Derives the frames per packet from channel count and sample format and starts a new packet sequence
+		void restart()
+		{
+			mSampleSize = utility::getVBANSampleSize(mSampleFormat);
+			const int max_frame_count = (VBAN_PROTOCOL_MAX_SIZE - VBAN_HEADER_SIZE) / (mChannelCount * mSampleSize);
+			mPacketFrameCount = std::clamp(max_frame_count, 1, utility::VBAN_MAX_PACKET_FRAME_COUNT);
+			getHeader().format_nbs = static_cast<uint8_t>(mPacketFrameCount - 1);
+
+			mPacket.resize(VBAN_HEADER_SIZE + mPacketFrameCount * mChannelCount * mSampleSize);
+			mFrameCount = 0;
+			mPacketCounter = 0;
+		}
+
+		Sender& mSender;
+		std::vector<char> mPacket;
+		std::vector<const float*> mChannels;
+		EVBANSampleFormat mSampleFormat = EVBANSampleFormat::Int16;
+		utility::VBANEncodeFunction mEncode = nullptr;
+		int mChannelCount = 1;
+		int mSampleSize = 2;
+		int mPacketFrameCount = 1;
+		int mFrameCount = 0;
+		uint32_t mPacketCounter = 0;
+	};
+
+}
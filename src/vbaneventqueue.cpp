@@ -0,0 +1,151 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vbaneventqueue.h"
+
+#include <nap/logger.h>
+#include <utility/stringutils.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+namespace nap
+{
+
+	// Queues that are logged on update. Guarded, a queue of an audio process can be destroyed on another thread than the main thread.
+	static std::mutex sQueuesMutex;
+	static std::vector<VBANEventQueue*> sQueues;
+
+
+	VBANEventQueue::VBANEventQueue(const std::string& source, int capacity) : mSource(source), mEvents(capacity)
+	{
+		std::lock_guard<std::mutex> lock(sQueuesMutex);
+		sQueues.emplace_back(this);
+	}
+
+
+	VBANEventQueue::~VBANEventQueue()
+	{
+		std::lock_guard<std::mutex> lock(sQueuesMutex);
+		sQueues.erase(std::remove(sQueues.begin(), sQueues.end(), this), sQueues.end());
+		log();
+	}
+
+
+	bool VBANEventQueue::post(EVBANEvent type, int64 value, const char* streamName)
+	{
+		Event event;
+		event.mType = type;
+		event.mValue = value;
+		event.mStreamName.fill('\0');
+		if (streamName != nullptr)
+			std::memcpy(event.mStreamName.data(), streamName, strnlen(streamName, VBAN_STREAM_NAME_SIZE));
+
+		// Never allocates, the cells of the queue are allocated on construction
+		if (mEvents.tryPush(event))
+			return true;
+		mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+
+	int VBANEventQueue::log()
+	{
+		int count = 0;
+		Event event;
+		while (mEvents.tryPop(event))
+		{
+			const auto message = getMessage(event);
+			switch (event.mType)
+			{
+			case EVBANEvent::ReadPositionOvertaking:
+			case EVBANEvent::ReadPositionReset:
+				nap::Logger::info("%s: %s", mSource.c_str(), message.c_str());
+				break;
+			case EVBANEvent::ReadPositionBehind:
+				nap::Logger::debug("%s: %s", mSource.c_str(), message.c_str());
+				break;
+			default:
+				nap::Logger::error("%s: %s", mSource.c_str(), message.c_str());
+				break;
+			}
+			++count;
+		}
+
+		const auto dropped = mDroppedCount.load(std::memory_order_relaxed);
+		if (dropped != mLoggedDroppedCount)
+		{
+			nap::Logger::warn("%s: %lld events dropped, the event queue was full", mSource.c_str(), static_cast<long long>(dropped - mLoggedDroppedCount));
+			mLoggedDroppedCount = dropped;
+		}
+		return count;
+	}
+
+
+	std::string VBANEventQueue::getMessage(const Event& event)
+	{
+		std::string message;
+		switch (event.mType)
+		{
+		case EVBANEvent::PacketTooSmall:
+			message = "Packet is smaller than the header size.";
+			break;
+		case EVBANEvent::PacketTooLarge:
+			message = "Packet exceeds maximum size.";
+			break;
+		case EVBANEvent::InvalidHeader:
+			message = "Invalid packet header ID.";
+			break;
+		case EVBANEvent::InvalidChannelCount:
+			message = "Channel count should be greater than zero.";
+			break;
+		case EVBANEvent::UnsupportedProtocol:
+			message = "Invalid protocol ID, only audio protocol supported.";
+			break;
+		case EVBANEvent::UnsupportedCodec:
+			message = "Invalid codec ID, only PCM codec supported.";
+			break;
+		case EVBANEvent::UnsupportedBitDepth:
+			message = utility::stringFormat("Unsupported bit depth, format %lld.", static_cast<long long>(event.mValue));
+			break;
+		case EVBANEvent::UnsupportedSampleRate:
+			message = utility::stringFormat("Unsupported sample rate, format %lld.", static_cast<long long>(event.mValue));
+			break;
+		case EVBANEvent::IncompletePacket:
+			message = "Packet is smaller than its audio data.";
+			break;
+		case EVBANEvent::ReadPositionOvertaking:
+			message = "Read position overtaking write position.";
+			break;
+		case EVBANEvent::ReadPositionBehind:
+			message = "Read position too far behind.";
+			break;
+		case EVBANEvent::ReadPositionReset:
+			message = utility::stringFormat("resetting read position. Time: %.2f", event.mValue / 60000.0);
+			break;
+		case EVBANEvent::ReceiveFailed:
+			message = utility::stringFormat("Receive failed: %s", std::system_category().message(static_cast<int>(event.mValue)).c_str());
+			break;
+		case EVBANEvent::SendFailed:
+			message = utility::stringFormat("Send failed: %s", std::system_category().message(static_cast<int>(event.mValue)).c_str());
+			break;
+		}
+
+		if (event.mStreamName[0] != '\0')
+			message += utility::stringFormat(" Stream: %.*s", static_cast<int>(strnlen(event.mStreamName.data(), VBAN_STREAM_NAME_SIZE)), event.mStreamName.data());
+		return message;
+	}
+
+
+	void VBANEventQueue::logAll()
+	{
+		std::lock_guard<std::mutex> lock(sQueuesMutex);
+		for (auto* queue : sQueues)
+			queue->log();
+	}
+
+}
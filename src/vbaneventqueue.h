@@ -0,0 +1,128 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <array>
+#include <atomic>
+#include <string>
+
+// Third party includes
+#include <vban/vban.h>
+
+// Nap includes
+#include <utility/dllexport.h>
+#include <nap/numeric.h>
+
+// Local includes
+#include "vbanboundedqueue.h"
+
+namespace nap
+{
+
+	/**
+	 * Events reported from the receiving and audio threads, logged on the main thread.
+	 */
+	enum class EVBANEvent : int
+	{
+		PacketTooSmall			= 0,	///< Packet is smaller than the VBAN header
+		PacketTooLarge			= 1,	///< Packet exceeds the maximum VBAN packet size
+		InvalidHeader			= 2,	///< Packet doesn't start with the VBAN header ID
+		InvalidChannelCount		= 3,	///< Channel count of the packet is not positive
+		UnsupportedProtocol		= 4,	///< Packet is not of the audio protocol
+		UnsupportedCodec		= 5,	///< Packet is not PCM encoded
+		UnsupportedBitDepth		= 6,	///< Value is the bit resolution format of the packet
+		UnsupportedSampleRate	= 7,	///< Value is the sample rate format of the packet
+		IncompletePacket		= 8,	///< Packet is smaller than its audio data
+		ReadPositionOvertaking	= 9,	///< Read position of a timeline overtook its write position
+		ReadPositionBehind		= 10,	///< Read position of a timeline fell more than the circular buffer behind
+		ReadPositionReset		= 11,	///< Read position of a timeline was reset, value is the sample time in milliseconds
+		ReceiveFailed			= 12,	///< Receiving datagrams failed, value is the system error code
+		SendFailed				= 13	///< Sending a packet failed, value is the system error code
+	};
+
+
+	/**
+	 * Fixed size lock-free ring of events, posted from threads that may not block, allocate or do I/O and logged on the main thread.
+	 * Events are small and trivially copyable, they are only formatted into messages when they are logged.
+	 * When the queue is full events are dropped and counted, a burst of errors never stalls the posting thread.
+	 * Every queue is logged by the VBANService on update, and once more when the queue is destroyed.
+	 */
+	class NAPAPI VBANEventQueue final
+	{
+	public:
+		static constexpr int sDefaultCapacity = 256;		///< Number of events the queue holds by default
+
+		/**
+		 * An event with a single value and the name of the stream it applies to.
+		 */
+		struct Event
+		{
+			EVBANEvent mType = EVBANEvent::PacketTooSmall;
+			int64 mValue = 0;									///< Meaning depends on the type, see EVBANEvent
+			std::array<char, VBAN_STREAM_NAME_SIZE> mStreamName;	///< Not null terminated when the name takes all characters, empty when not applicable
+		};
+
+		/**
+		 * Preallocates the queue and registers it for logging, call from the main thread.
+		 * @param source Prepended to every logged message
+		 * @param capacity Number of events the queue holds
+		 */
+		VBANEventQueue(const std::string& source, int capacity = sDefaultCapacity);
+
+		/**
+		 * Logs the events that are still queued and unregisters the queue, call from the main thread.
+		 */
+		~VBANEventQueue();
+
+		VBANEventQueue(const VBANEventQueue&) = delete;
+		VBANEventQueue& operator=(const VBANEventQueue&) = delete;
+
+		/**
+		 * Sets the text prepended to every logged message, call from the main thread while no events are logged.
+		 * @param source The text to prepend
+		 */
+		void setSource(const std::string& source) { mSource = source; }
+
+		/**
+		 * Queues an event without locking or allocating, drops it when the queue is full. Thread-Safe
+		 * @param type The type of event
+		 * @param value Value of the event, see EVBANEvent
+		 * @param streamName Name of the stream the event applies to, at most VBAN_STREAM_NAME_SIZE characters are copied. Can be nullptr.
+		 * @return False when the event was dropped.
+		 */
+		bool post(EVBANEvent type, int64 value = 0, const char* streamName = nullptr);
+
+		/**
+		 * Logs and removes all queued events, and the number of events dropped since the last call. Call from the main thread.
+		 * @return The number of events logged.
+		 */
+		int log();
+
+		/**
+		 * @return The number of events dropped because the queue was full, since construction. Thread-Safe
+		 */
+		int64 getDroppedCount() const { return mDroppedCount.load(); }
+
+		/**
+		 * Formats the message of an event, without the source.
+		 * @param event The event
+		 * @return The message
+		 */
+		static std::string getMessage(const Event& event);
+
+		/**
+		 * Logs the events of all queues, called by the VBANService on update.
+		 */
+		static void logAll();
+
+	private:
+		std::string mSource;
+		VBANBoundedQueue<Event> mEvents;
+		std::atomic<int64> mDroppedCount = { 0 };
+		int64 mLoggedDroppedCount = 0;				// Dropped events already reported, only accessed by the main thread
+	};
+
+}
@@ -0,0 +1,296 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifdef __linux__
+
+#include "vbaniouring.h"
+
+// Std includes
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+
+// Linux includes
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace nap
+{
+
+	// Group id of the provided buffers
+	static constexpr uint16_t sBufferGroup = 0;
+
+	// Maximum number of entries in a provided buffer ring
+	static constexpr int sMaxBufferCount = 32768;
+
+
+	// io_uring is used through its system calls directly, liburing is not required
+	static int ioUringSetup(unsigned entries, io_uring_params* params)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+	}
+
+
+	static int ioUringEnter(int ringFD, unsigned submitCount, unsigned minCompleteCount, unsigned flags, void* argument, size_t argumentSize)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_enter, ringFD, submitCount, minCompleteCount, flags, argument, argumentSize));
+	}
+
+
+	static int ioUringRegister(int ringFD, unsigned opcode, void* argument, unsigned argumentCount)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_register, ringFD, opcode, argument, argumentCount));
+	}
+
+
+	// Maps a region of the ring, returns nullptr on failure
+	static void* mapRing(int ringFD, size_t size, off_t offset)
+	{
+		void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD, offset);
+		return region == MAP_FAILED ? nullptr : region;
+	}
+
+
+	VBANIOUring::~VBANIOUring()
+	{
+		if (mBufferRing != nullptr)
+			munmap(mBufferRing, mBufferRingSize);
+		if (mSubmissionEntries != nullptr)
+			munmap(mSubmissionEntries, mSubmissionEntriesSize);
+		if (mCompletionRing != nullptr && mCompletionRing != mSubmissionRing)
+			munmap(mCompletionRing, mCompletionRingSize);
+		if (mSubmissionRing != nullptr)
+			munmap(mSubmissionRing, mSubmissionRingSize);
+		if (mRingFD >= 0)
+			close(mRingFD);
+	}
+
+
+	bool VBANIOUring::init(int socket, int bufferCount, utility::ErrorState& errorState)
+	{
+		if (!errorState.check(bufferCount > 0 && bufferCount <= sMaxBufferCount, "io_uring buffer count must be between 1 and %i", sMaxBufferCount))
+			return false;
+
+		mSocket = socket;
+		mBufferCount = 1;
+		while (mBufferCount < static_cast<unsigned>(bufferCount))
+			mBufferCount <<= 1;
+
+		// A single submission is kept armed, the completion queue holds a completion for every provided buffer
+		io_uring_params params = {};
+		params.flags = IORING_SETUP_CQSIZE;
+		params.cq_entries = mBufferCount * 2;
+		mRingFD = ioUringSetup(4, &params);
+		if (!errorState.check(mRingFD >= 0, "io_uring is not available: %s", strerror(errno)))
+			return false;
+		if (!errorState.check((params.features & IORING_FEAT_EXT_ARG) != 0, "io_uring doesn't support waiting with a timeout"))
+			return false;
+
+		// Map the submission and completion queues, recent kernels share a single mapping for both
+		mSubmissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		mCompletionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool single_mapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single_mapping)
+			mSubmissionRingSize = mCompletionRingSize = std::max(mSubmissionRingSize, mCompletionRingSize);
+
+		mSubmissionRing = mapRing(mRingFD, mSubmissionRingSize, IORING_OFF_SQ_RING);
+		if (!errorState.check(mSubmissionRing != nullptr, "Failed to map io_uring submission queue: %s", strerror(errno)))
+			return false;
+		mCompletionRing = single_mapping ? mSubmissionRing : mapRing(mRingFD, mCompletionRingSize, IORING_OFF_CQ_RING);
+		if (!errorState.check(mCompletionRing != nullptr, "Failed to map io_uring completion queue: %s", strerror(errno)))
+			return false;
+		mSubmissionEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+		mSubmissionEntries = mapRing(mRingFD, mSubmissionEntriesSize, IORING_OFF_SQES);
+		if (!errorState.check(mSubmissionEntries != nullptr, "Failed to map io_uring submission entries: %s", strerror(errno)))
+			return false;
+
+		auto* submission_ring = static_cast<uint8_t*>(mSubmissionRing);
+		mSubmissionTail = reinterpret_cast<unsigned*>(submission_ring + params.sq_off.tail);
+		mSubmissionMask = *reinterpret_cast<unsigned*>(submission_ring + params.sq_off.ring_mask);
+		mSubmissionArray = reinterpret_cast<unsigned*>(submission_ring + params.sq_off.array);
+
+		auto* completion_ring = static_cast<uint8_t*>(mCompletionRing);
+		mCompletionHead = reinterpret_cast<unsigned*>(completion_ring + params.cq_off.head);
+		mCompletionTail = reinterpret_cast<unsigned*>(completion_ring + params.cq_off.tail);
+		mCompletionMask = *reinterpret_cast<unsigned*>(completion_ring + params.cq_off.ring_mask);
+		mCompletions = completion_ring + params.cq_off.cqes;
+
+		// Register the ring of provided buffers, every buffer receives the recvmsg header, sender address, ancillary data and payload of one datagram
+		mBufferRingSize = mBufferCount * sizeof(io_uring_buf);
+		mBufferRing = mmap(nullptr, mBufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mBufferRing == MAP_FAILED)
+		{
+			mBufferRing = nullptr;
+			errorState.fail("Failed to allocate io_uring buffer ring: %s", strerror(errno));
+			return false;
+		}
+
+		io_uring_buf_reg registration = {};
+		registration.ring_addr = reinterpret_cast<uint64_t>(mBufferRing);
+		registration.ring_entries = mBufferCount;
+		registration.bgid = sBufferGroup;
+		if (!errorState.check(ioUringRegister(mRingFD, IORING_REGISTER_PBUF_RING, &registration, 1) == 0, "io_uring provided buffer rings are not supported: %s", strerror(errno)))
+			return false;
+
+		mMessage.msg_namelen = sizeof(sockaddr_in);
+		mMessage.msg_controllen = CMSG_SPACE(sizeof(timespec));
+		mBufferSize = sizeof(io_uring_recvmsg_out) + mMessage.msg_namelen + mMessage.msg_controllen + VBAN_PROTOCOL_MAX_SIZE;
+		mBuffers.resize(mBufferSize * mBufferCount);
+		mReleasedBuffers = std::make_unique<VBANBoundedQueue<uint16_t>>(static_cast<int>(mBufferCount));
+		for (unsigned i = 0; i < mBufferCount; ++i)
+			recycleBuffer(static_cast<uint16_t>(i));
+
+		// Arm the receive, kernels without multishot recvmsg reject the submission right away
+		arm();
+		submit();
+		const unsigned head = *mCompletionHead;
+		if (head != __atomic_load_n(mCompletionTail, __ATOMIC_ACQUIRE))
+		{
+			const auto& completion = static_cast<io_uring_cqe*>(mCompletions)[head & mCompletionMask];
+			if (!errorState.check(completion.res != -EINVAL, "io_uring multishot recvmsg is not supported by this kernel"))
+				return false;
+		}
+
+		mDatagrams.reserve(mBufferCount);
+		return true;
+	}
+
+
+	const std::vector<VBANIOUring::Datagram>& VBANIOUring::receive(int maxCount, int timeoutMilliseconds)
+	{
+		mDatagrams.clear();
+		uint16_t released_buffer = 0;
+		while (mReleasedBuffers->tryPop(released_buffer))
+			recycleBuffer(released_buffer);
+
+		// The multishot receive ends when the kernel runs out of buffers or on error, arm it again
+		if (!mArmed)
+			arm();
+
+		unsigned head = *mCompletionHead;
+		unsigned tail = __atomic_load_n(mCompletionTail, __ATOMIC_ACQUIRE);
+		if (head == tail || mPendingSubmissions > 0)
+		{
+			__kernel_timespec timeout = { timeoutMilliseconds / 1000, (timeoutMilliseconds % 1000) * 1000000 };
+			io_uring_getevents_arg argument = {};
+			argument.sigmask_sz = _NSIG / 8;
+			argument.ts = reinterpret_cast<uint64_t>(&timeout);
+			const bool wait = head == tail;
+			int result = ioUringEnter(mRingFD, mPendingSubmissions, wait ? 1 : 0, IORING_ENTER_EXT_ARG | (wait ? IORING_ENTER_GETEVENTS : 0), &argument, sizeof(argument));
+			if (result > 0)
+				mPendingSubmissions -= std::min<unsigned>(result, mPendingSubmissions);
+			tail = __atomic_load_n(mCompletionTail, __ATOMIC_ACQUIRE);
+		}
+
+		while (head != tail && static_cast<int>(mDatagrams.size()) < maxCount)
+		{
+			const auto& completion = static_cast<io_uring_cqe*>(mCompletions)[head & mCompletionMask];
+			++head;
+
+			if ((completion.flags & IORING_CQE_F_MORE) == 0)
+				mArmed = false;
+			if (completion.res < 0 || (completion.flags & IORING_CQE_F_BUFFER) == 0)
+				continue;
+
+			const auto buffer_id = static_cast<uint16_t>(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+
+			// Datagrams that don't fit a VBAN packet are truncated and skipped
+			uint8_t* buffer = mBuffers.data() + buffer_id * mBufferSize;
+			io_uring_recvmsg_out header;
+			std::memcpy(&header, buffer, sizeof(header));
+			if ((header.flags & MSG_TRUNC) != 0)
+			{
+				recycleBuffer(buffer_id);
+				continue;
+			}
+
+			mHeldBufferCount.fetch_add(1, std::memory_order_relaxed);
+			Datagram& datagram = mDatagrams.emplace_back();
+			datagram.mBufferID = buffer_id;
+			uint8_t* name = buffer + sizeof(io_uring_recvmsg_out);
+			if (header.namelen >= sizeof(sockaddr_in))
+			{
+				sockaddr_in source;
+				std::memcpy(&source, name, sizeof(source));
+				datagram.mSource = { ntohl(source.sin_addr.s_addr), ntohs(source.sin_port) };
+			}
+
+			msghdr control = {};
+			control.msg_control = name + mMessage.msg_namelen;
+			control.msg_controllen = header.controllen;
+			for (auto* message = CMSG_FIRSTHDR(&control); message != nullptr; message = CMSG_NXTHDR(&control, message))
+			{
+				if (message->cmsg_level == SOL_SOCKET && message->cmsg_type == SCM_TIMESTAMPNS)
+				{
+					timespec time;
+					std::memcpy(&time, CMSG_DATA(message), sizeof(time));
+					datagram.mTimestamp = static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+				}
+			}
+
+			datagram.mData = name + mMessage.msg_namelen + mMessage.msg_controllen;
+			datagram.mSize = header.payloadlen;
+		}
+
+		__atomic_store_n(mCompletionHead, head, __ATOMIC_RELEASE);
+		return mDatagrams;
+	}
+
+
+	void VBANIOUring::releaseBuffer(uint16_t bufferID)
+	{
+		// Every buffer is held at most once, so the queue is never full
+		mReleasedBuffers->tryPush(bufferID);
+		mHeldBufferCount.fetch_sub(1, std::memory_order_release);
+	}
+
+
+	void VBANIOUring::arm()
+	{
+		const unsigned tail = *mSubmissionTail;
+		const unsigned index = tail & mSubmissionMask;
+		auto& entry = static_cast<io_uring_sqe*>(mSubmissionEntries)[index];
+		std::memset(&entry, 0, sizeof(entry));
+		entry.opcode = IORING_OP_RECVMSG;
+		entry.fd = mSocket;
+		entry.addr = reinterpret_cast<uint64_t>(&mMessage);
+		entry.len = 1;
+		entry.ioprio = IORING_RECV_MULTISHOT;
+		entry.flags = IOSQE_BUFFER_SELECT;
+		entry.buf_group = sBufferGroup;
+		mSubmissionArray[index] = index;
+		__atomic_store_n(mSubmissionTail, tail + 1, __ATOMIC_RELEASE);
+
+		++mPendingSubmissions;
+		mArmed = true;
+	}
+
+
+	void VBANIOUring::submit()
+	{
+		int result = ioUringEnter(mRingFD, mPendingSubmissions, 0, 0, nullptr, 0);
+		if (result > 0)
+			mPendingSubmissions -= std::min<unsigned>(result, mPendingSubmissions);
+	}
+
+
+	void VBANIOUring::recycleBuffer(uint16_t bufferID)
+	{
+		// Only fill in the address, length and id, the reserved field of the first entry overlaps the tail of the ring
+		auto& entry = static_cast<io_uring_buf*>(mBufferRing)[mBufferTail & (mBufferCount - 1)];
+		entry.addr = reinterpret_cast<uint64_t>(mBuffers.data() + bufferID * mBufferSize);
+		entry.len = static_cast<uint32_t>(mBufferSize);
+		entry.bid = bufferID;
+		++mBufferTail;
+		__atomic_store_n(&static_cast<io_uring_buf_ring*>(mBufferRing)->tail, mBufferTail, __ATOMIC_RELEASE);
+	}
+
+}
+
+#endif // __linux__
@@ -0,0 +1,131 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#ifdef __linux__
+
+// Std includes
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <sys/socket.h>
+
+// Nap includes
+#include <utility/dllexport.h>
+#include <utility/errorstate.h>
+
+// Local includes
+#include "vbanstreamkey.h"
+#include "vbanpacket.h"
+#include "vbanboundedqueue.h"
+
+namespace nap
+{
+
+	/**
+	 * Receives datagrams from a UDP socket through io_uring, Linux only.
+	 * A single multishot recvmsg request stays armed on the socket and the kernel receives into a ring of provided buffers,
+	 * so datagrams that arrive while the thread is busy are collected without any system call.
+	 * Received buffers are handed out without copying, packets can refer to them until they are released.
+	 * Except for releaseBuffer() all calls are expected to be made from the receiving thread.
+	 */
+	class NAPAPI VBANIOUring final : public VBANPacketBufferOwner
+	{
+	public:
+		/**
+		 * A received datagram, pointing into one of the provided buffers.
+		 * The buffer belongs to the caller until it is handed back with releaseBuffer().
+		 */
+		struct Datagram
+		{
+			uint8_t* mData = nullptr;			///< Payload
+			size_t mSize = 0;					///< Payload size in bytes
+			uint16_t mBufferID = 0;				///< Id of the buffer holding the datagram
+			VBANEndpoint mSource;				///< Sender of the datagram
+			int64_t mTimestamp = 0;				///< Kernel receive time in nanoseconds since the epoch
+		};
+
+		VBANIOUring() = default;
+		~VBANIOUring() override;
+
+		VBANIOUring(const VBANIOUring&) = delete;
+		VBANIOUring& operator=(const VBANIOUring&) = delete;
+
+		/**
+		 * Creates the ring, registers the provided buffers and arms the multishot receive on the socket.
+		 * Fails on kernels without io_uring, provided buffer rings (5.19) or multishot recvmsg (6.0).
+		 * @param socket UDP socket with SO_TIMESTAMPNS enabled
+		 * @param bufferCount Number of provided buffers, rounded up to a power of two
+		 * @param errorState Contains the error when the ring could not be set up
+		 * @return If the ring is ready to receive
+		 */
+		bool init(int socket, int bufferCount, utility::ErrorState& errorState);
+
+		/**
+		 * Collects up to maxCount received datagrams, waits when none are available yet.
+		 * First hands the buffers that were released since the previous call back to the kernel.
+		 * Every returned datagram keeps its buffer until releaseBuffer() is called with its id.
+		 * @param maxCount Maximum number of datagrams to collect
+		 * @param timeoutMilliseconds Maximum time to wait for the first datagram
+		 * @return The collected datagrams, empty on timeout
+		 */
+		const std::vector<Datagram>& receive(int maxCount, int timeoutMilliseconds);
+
+		/**
+		 * Marks the buffer of a received datagram as free, it is handed back to the kernel on the next receive(). Thread-Safe
+		 * @param bufferID Id of the buffer
+		 */
+		void releaseBuffer(uint16_t bufferID) override;
+
+		/**
+		 * @return Number of received buffers that haven't been released yet. Thread-Safe
+		 */
+		int getHeldBufferCount() const override { return mHeldBufferCount.load(std::memory_order_acquire); }
+
+	private:
+		void arm();
+		void submit();
+		void recycleBuffer(uint16_t bufferID);
+
+		int mRingFD = -1;
+		int mSocket = -1;
+
+		// Submission and completion queues, shared with the kernel
+		void* mSubmissionRing = nullptr;
+		size_t mSubmissionRingSize = 0;
+		void* mCompletionRing = nullptr;
+		size_t mCompletionRingSize = 0;
+		void* mSubmissionEntries = nullptr;
+		size_t mSubmissionEntriesSize = 0;
+		unsigned* mSubmissionTail = nullptr;
+		unsigned* mSubmissionArray = nullptr;
+		unsigned mSubmissionMask = 0;
+		unsigned* mCompletionHead = nullptr;
+		unsigned* mCompletionTail = nullptr;
+		unsigned mCompletionMask = 0;
+		void* mCompletions = nullptr;
+		unsigned mPendingSubmissions = 0;
+
+		// Provided buffers, the kernel picks a free one for every datagram
+		void* mBufferRing = nullptr;
+		size_t mBufferRingSize = 0;
+		std::vector<uint8_t> mBuffers;
+		size_t mBufferSize = 0;
+		unsigned mBufferCount = 0;
+		uint16_t mBufferTail = 0;
+
+		// Message header describing the space reserved for the sender address and ancillary data in every buffer
+		msghdr mMessage = {};
+
+		std::vector<Datagram> mDatagrams;
+		std::unique_ptr<VBANBoundedQueue<uint16_t>> mReleasedBuffers;	// Released from any thread, recycled by the receiving thread
+		std::atomic<int> mHeldBufferCount = { 0 };
+		bool mArmed = false;
+	};
+
+}
+
+#endif // __linux__
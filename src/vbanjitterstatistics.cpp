@@ -0,0 +1,110 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vbanjitterstatistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace nap
+{
+
+	VBANJitterStatistics::VBANJitterStatistics()
+	{
+		for (auto& bin : mHistogram)
+			bin.store(0, std::memory_order_relaxed);
+	}
+
+
+	void VBANJitterStatistics::addArrival(int64_t timestamp, uint32_t packetCounter, int frameCount, int sampleRate)
+	{
+		if (mReset.exchange(false))
+			clear();
+
+		const double nominal = frameCount * 1e9 / sampleRate;
+
+		// Interarrival jitter of RFC 3550 section 6.4.1, the difference of the relative transit times of successive arrivals.
+		// The media time of a packet is derived from its counter, lost and reordered packets are included like the RFC does.
+		// A sender that restarts starts over with a new transit time.
+		const auto counter_difference = static_cast<int32_t>(packetCounter - mLastPacketCounter);
+		if (mHasLastArrival && packetCounter != 0)
+		{
+			const double difference = static_cast<double>(timestamp - mLastTimestamp) - counter_difference * nominal;
+			mJitter += (std::abs(difference) - mJitter) / 16.0;
+			mPublishedJitter.store(static_cast<float>(mJitter / 1000.0), std::memory_order_relaxed);
+		}
+
+		if (mHasLastArrival && counter_difference == 1)
+		{
+			const int64_t interval = std::max<int64_t>(timestamp - mLastTimestamp, 0);
+
+			auto bin = std::min<int64_t>(interval / (sBinWidth * 1000), sBinCount - 1);
+			mHistogram[bin].fetch_add(1, std::memory_order_relaxed);
+			mIntervalSum.fetch_add(interval, std::memory_order_relaxed);
+			if (interval < mMinInterval.load(std::memory_order_relaxed))
+				mMinInterval.store(interval, std::memory_order_relaxed);
+			if (interval > mMaxInterval.load(std::memory_order_relaxed))
+				mMaxInterval.store(interval, std::memory_order_relaxed);
+
+			mNominalInterval.store(static_cast<float>(nominal / 1000.0), std::memory_order_relaxed);
+
+			// Published last, readers use the count to compute the mean
+			mCount.fetch_add(1, std::memory_order_release);
+		}
+
+		mLastTimestamp = timestamp;
+		mLastPacketCounter = packetCounter;
+		mHasLastArrival = true;
+	}
+
+
+	void VBANJitterStatistics::getSnapshot(Snapshot& snapshot) const
+	{
+		snapshot.mCount = mCount.load(std::memory_order_acquire);
+		snapshot.mNominalInterval = mNominalInterval.load(std::memory_order_relaxed);
+		snapshot.mJitter = mPublishedJitter.load(std::memory_order_relaxed);
+		snapshot.mMaxInterval = mMaxInterval.load(std::memory_order_relaxed) / 1000.f;
+		auto min_interval = mMinInterval.load(std::memory_order_relaxed);
+		snapshot.mMinInterval = snapshot.mCount > 0 ? min_interval / 1000.f : 0.f;
+		snapshot.mMeanInterval = snapshot.mCount > 0 ? (mIntervalSum.load(std::memory_order_relaxed) / snapshot.mCount) / 1000.f : 0.f;
+		for (auto i = 0; i < sBinCount; ++i)
+			snapshot.mHistogram[i] = mHistogram[i].load(std::memory_order_relaxed);
+	}
+
+
+	void VBANJitterStatistics::clear()
+	{
+		for (auto& bin : mHistogram)
+			bin.store(0, std::memory_order_relaxed);
+		mCount.store(0, std::memory_order_relaxed);
+		mIntervalSum.store(0, std::memory_order_relaxed);
+		mMinInterval.store(std::numeric_limits<int64_t>::max(), std::memory_order_relaxed);
+		mMaxInterval.store(0, std::memory_order_relaxed);
+		mJitter = 0.0;
+		mPublishedJitter.store(0.f, std::memory_order_relaxed);
+		mHasLastArrival = false;
+	}
+
+
+	float VBANJitterStatistics::Snapshot::getPercentile(float fraction) const
+	{
+		int64_t total = 0;
+		for (auto count : mHistogram)
+			total += count;
+		if (total == 0)
+			return 0.f;
+
+		// Upper edge of the bin in which the requested fraction of intervals is reached
+		const auto target = static_cast<int64_t>(std::ceil(std::clamp(fraction, 0.f, 1.f) * total));
+		int64_t accumulated = 0;
+		for (auto i = 0; i < sBinCount; ++i)
+		{
+			accumulated += mHistogram[i];
+			if (accumulated >= target && accumulated > 0)
+				return static_cast<float>((i + 1) * sBinWidth);
+		}
+		return static_cast<float>(sBinCount * sBinWidth);
+	}
+
+}
@@ -0,0 +1,94 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+// Nap includes
+#include <utility/dllexport.h>
+
+namespace nap
+{
+
+	/**
+	 * Inter-arrival statistics of the packets of a single VBAN stream, measured on the kernel receive timestamps.
+	 * Updated from the receiving thread and read from any other thread without locking.
+	 * Intervals are collected in a fixed size histogram so percentiles can be derived without storing individual arrivals.
+	 */
+	class NAPAPI VBANJitterStatistics
+	{
+	public:
+		static constexpr int sBinWidth = 10;		///< Width of a histogram bin in microseconds
+		static constexpr int sBinCount = 1000;		///< Number of histogram bins, longer intervals are counted in the last bin
+
+		/**
+		 * Copy of the statistics at a certain moment. All times are in microseconds.
+		 */
+		struct Snapshot
+		{
+			int64_t mCount = 0;					///< Number of measured intervals
+			float mNominalInterval = 0.f;		///< Interval at which the packets are sent, derived from frame count and sample rate
+			float mMinInterval = 0.f;			///< Shortest measured interval
+			float mMaxInterval = 0.f;			///< Longest measured interval
+			float mMeanInterval = 0.f;			///< Mean measured interval
+			float mJitter = 0.f;				///< Interarrival jitter of RFC 3550: the transit time differences of successive packets, smoothed with J += (|D| - J) / 16
+			std::array<uint32_t, sBinCount> mHistogram;	///< Number of intervals per bin of sBinWidth microseconds
+
+			/**
+			 * @param fraction Fraction of the intervals, between 0 and 1
+			 * @return The interval in microseconds that the given fraction of the intervals does not exceed.
+			 */
+			float getPercentile(float fraction) const;
+		};
+
+		VBANJitterStatistics();
+
+		/**
+		 * Registers the arrival of a packet, called from the receiving thread.
+		 * Only intervals between consecutive packets are measured, lost packets don't distort the interval statistics.
+		 * The jitter is updated for every arrival, with the media time of the packets derived from their packet counters.
+		 * @param timestamp Arrival time of the packet in nanoseconds
+		 * @param packetCounter Packet counter from the VBAN header
+		 * @param frameCount Number of frames in the packet
+		 * @param sampleRate Sample rate of the stream
+		 */
+		void addArrival(int64_t timestamp, uint32_t packetCounter, int frameCount, int sampleRate);
+
+		/**
+		 * Copies the current statistics. Thread-Safe
+		 * @param snapshot Receives the statistics
+		 */
+		void getSnapshot(Snapshot& snapshot) const;
+
+		/**
+		 * Clears the statistics, takes effect on the next arrival. Thread-Safe
+		 */
+		void reset() { mReset.store(true); }
+
+	private:
+		void clear();
+
+		// Only accessed by the receiving thread
+		int64_t mLastTimestamp = 0;
+		uint32_t mLastPacketCounter = 0;
+		bool mHasLastArrival = false;
+		double mJitter = 0.0;
+
+		// Published to readers
+		std::array<std::atomic<uint32_t>, sBinCount> mHistogram;
+		std::atomic<int64_t> mCount = { 0 };
+		std::atomic<int64_t> mIntervalSum = { 0 };
+		std::atomic<int64_t> mMinInterval = { std::numeric_limits<int64_t>::max() };
+		std::atomic<int64_t> mMaxInterval = { 0 };
+		std::atomic<float> mNominalInterval = { 0.f };
+		std::atomic<float> mPublishedJitter = { 0.f };
+		std::atomic<bool> mReset = { false };
+	};
+
+}
@@ -0,0 +1,67 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vbanpacket.h"
+
+namespace nap
+{
+
+	void VBANPacket::release() const
+	{
+		auto count = mReferenceCount.fetch_sub(1) - 1;
+		assert(count >= 0);
+		if (count != 0)
+			return;
+
+		// Hand the external buffer back before the packet can be acquired again
+		if (mBufferOwner != nullptr)
+			mBufferOwner->releaseBuffer(mBufferID);
+		if (mPool != nullptr)
+			mPool->recycle(const_cast<VBANPacket*>(this));
+	}
+
+
+	void VBANPacket::setExternalData(uint8_t* data, size_t size, VBANPacketBufferOwner& owner, uint16_t bufferID)
+	{
+		assert(mBufferOwner == nullptr && size <= capacity());
+		mData = data;
+		mSize = size;
+		mBufferOwner = &owner;
+		mBufferID = bufferID;
+	}
+
+
+	VBANPacketPool::VBANPacketPool(int size) : mSize(size), mPackets(std::make_unique<VBANPacket[]>(size)), mFreePackets(size)
+	{
+		for (auto i = 0; i < size; ++i)
+		{
+			mPackets[i].mPool = this;
+			mFreePackets.tryPush(&mPackets[i]);
+		}
+	}
+
+
+	VBANPacket* VBANPacketPool::acquire()
+	{
+		VBANPacket* packet = nullptr;
+		if (!mFreePackets.tryPop(packet))
+			return nullptr;
+
+		packet->mData = packet->mStorage.data();
+		packet->mBufferOwner = nullptr;
+		packet->mSize = 0;
+		packet->mSource = { };
+		packet->mTimestamp = 0;
+		packet->mReferenceCount.store(1);
+		return packet;
+	}
+
+
+	void VBANPacketPool::recycle(VBANPacket* packet)
+	{
+		// The queue holds every packet of the pool, so it is never full
+		mFreePackets.tryPush(packet);
+	}
+
+}
@@ -0,0 +1,201 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <array>
+#include <cassert>
+#include <atomic>
+#include <memory>
+
+// Third party includes
+#include <vban/vban.h>
+
+// Nap includes
+#include <utility/dllexport.h>
+
+// Local includes
+#include "vbanstreamkey.h"
+#include "vbanboundedqueue.h"
+
+namespace nap
+{
+	// Forward declares
+	class VBANPacketPool;
+
+	/**
+	 * Owner of memory that packets can refer to instead of copying the data into their own storage,
+	 * for example the buffers the kernel received datagrams into.
+	 */
+	class NAPAPI VBANPacketBufferOwner
+	{
+	public:
+		virtual ~VBANPacketBufferOwner() = default;
+
+		/**
+		 * Called when the last reference to a packet that refers to the buffer is released. Thread-Safe
+		 * @param bufferID Id of the buffer, as handed to VBANPacket::setExternalData()
+		 */
+		virtual void releaseBuffer(uint16_t bufferID) = 0;
+
+		/**
+		 * @return Number of buffers that packets still refer to. Thread-Safe
+		 */
+		virtual int getHeldBufferCount() const = 0;
+	};
+
+
+	/**
+	 * A single received VBAN datagram.
+	 * Packets are preallocated by a VBANPacketPool and received into directly, listeners are handed a reference to the packet instead of a copy.
+	 * A listener that needs the packet after its callback returns, for example to process it on another thread, can retain() it and release() it when done.
+	 * The packet is returned to its pool when the last reference is released.
+	 * Instead of its own storage a packet can refer to an external buffer, which is handed back to its owner together with the packet.
+	 */
+	class NAPAPI VBANPacket
+	{
+		friend class VBANPacketPool;
+
+	public:
+		VBANPacket() = default;
+		VBANPacket(const VBANPacket&) = delete;
+		VBANPacket& operator=(const VBANPacket&) = delete;
+
+		/**
+		 * @return Pointer to the received data.
+		 */
+		const uint8_t* data() const { return mData; }
+
+		/**
+		 * @return Pointer to the data to receive into.
+		 */
+		uint8_t* data() { return mData; }
+
+		/**
+		 * @return The number of received bytes.
+		 */
+		size_t size() const { return mSize; }
+
+		/**
+		 * @return The maximum number of bytes the packet can hold.
+		 */
+		constexpr size_t capacity() const { return VBAN_PROTOCOL_MAX_SIZE; }
+
+		/**
+		 * @return True when no data has been received into the packet.
+		 */
+		bool empty() const { return mSize == 0; }
+
+		/**
+		 * Sets the number of received bytes.
+		 * @param size Number of received bytes, can not exceed the capacity.
+		 */
+		void setSize(size_t size) { assert(size <= capacity()); mSize = size; }
+
+		/**
+		 * Lets the packet refer to received data in an external buffer instead of its own storage, so the data doesn't have to be copied.
+		 * The buffer is handed back to its owner when the last reference to the packet is released.
+		 * @param data The received data
+		 * @param size Number of received bytes, can not exceed the capacity.
+		 * @param owner Owner of the buffer, must outlive the packet
+		 * @param bufferID Id of the buffer, passed to the owner on release
+		 */
+		void setExternalData(uint8_t* data, size_t size, VBANPacketBufferOwner& owner, uint16_t bufferID);
+
+		/**
+		 * @return The endpoint the packet was sent from.
+		 */
+		const VBANEndpoint& getSource() const { return mSource; }
+
+		/**
+		 * Sets the endpoint the packet was sent from.
+		 * @param source The sender endpoint.
+		 */
+		void setSource(const VBANEndpoint& source) { mSource = source; }
+
+		/**
+		 * @return Arrival time of the packet in nanoseconds since the epoch, taken by the kernel when supported.
+		 */
+		int64_t getTimestamp() const { return mTimestamp; }
+
+		/**
+		 * Sets the arrival time of the packet.
+		 * @param timestamp Arrival time in nanoseconds since the epoch.
+		 */
+		void setTimestamp(int64_t timestamp) { mTimestamp = timestamp; }
+
+		/**
+		 * @return The VBAN header at the start of the packet data.
+		 */
+		const VBanHeader& getHeader() const { return *reinterpret_cast<const VBanHeader*>(mData); }
+
+		/**
+		 * Adds a reference to the packet, keeping it out of the pool until it is released again. Thread-Safe
+		 */
+		void retain() const { mReferenceCount.fetch_add(1); }
+
+		/**
+		 * Removes a reference from the packet, the packet returns to its pool when this was the last reference. Thread-Safe
+		 */
+		void release() const;
+
+		/**
+		 * @return True when the caller holds the only reference to the packet.
+		 */
+		bool isUnique() const { return mReferenceCount.load() == 1; }
+
+	private:
+		std::array<uint8_t, VBAN_PROTOCOL_MAX_SIZE> mStorage;
+		uint8_t* mData = mStorage.data();				// Either the own storage or an external buffer
+		VBANPacketBufferOwner* mBufferOwner = nullptr;	// Set when referring to an external buffer
+		uint16_t mBufferID = 0;
+		size_t mSize = 0;
+		VBANEndpoint mSource;
+		int64_t mTimestamp = 0;
+		mutable std::atomic<int> mReferenceCount = { 0 };
+		VBANPacketPool* mPool = nullptr;
+	};
+
+
+	/**
+	 * Fixed size pool of preallocated VBAN packets.
+	 * Acquiring and releasing packets is lock-free and never allocates.
+	 */
+	class NAPAPI VBANPacketPool
+	{
+		friend class VBANPacket;
+
+	public:
+		/**
+		 * Constructor, allocates all packets in the pool up front.
+		 * @param size Number of packets in the pool.
+		 */
+		VBANPacketPool(int size);
+
+		/**
+		 * Takes a packet from the pool. The packet is handed out with a single reference owned by the caller. Thread-Safe
+		 * @return The packet, nullptr when all packets are in use.
+		 */
+		VBANPacket* acquire();
+
+		/**
+		 * @return Total number of packets in the pool.
+		 */
+		int getSize() const { return mSize; }
+
+		/**
+		 * @return Number of packets currently available in the pool.
+		 */
+		int getAvailableCount() const { return mFreePackets.getSizeApprox(); }
+
+	private:
+		void recycle(VBANPacket* packet);
+
+		int mSize = 0;
+		std::unique_ptr<VBANPacket[]> mPackets;
+		VBANBoundedQueue<VBANPacket*> mFreePackets;
+	};
+
+}
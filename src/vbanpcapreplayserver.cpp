@@ -0,0 +1,449 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vbanpcapreplayserver.h"
+
+// Nap includes
+#include <nap/logger.h>
+
+// Std includes
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+RTTI_BEGIN_CLASS(nap::VBANPcapReplayServer)
+	RTTI_PROPERTY_FILELINK("File", &nap::VBANPcapReplayServer::mFile, nap::rtti::EPropertyMetaData::Required, nap::rtti::EPropertyFileType::Any)
+	RTTI_PROPERTY("Speed", &nap::VBANPcapReplayServer::mSpeed, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("Loop", &nap::VBANPcapReplayServer::mLoop, nap::rtti::EPropertyMetaData::Default)
+RTTI_END_CLASS
+
+namespace nap
+{
+
+	// Link layer types of the captured frames
+	static constexpr int sLinkTypeNull		= 0;
+	static constexpr int sLinkTypeEthernet	= 1;
+	static constexpr int sLinkTypeRaw		= 101;
+	static constexpr int sLinkTypeLoop		= 108;
+	static constexpr int sLinkTypeLinuxSLL	= 113;
+	static constexpr int sLinkTypeIPv4		= 228;
+	static constexpr int sLinkTypeLinuxSLL2	= 276;
+
+
+	// Reads integers from the capture in the byte order of the file
+	class CaptureReader
+	{
+	public:
+		CaptureReader(const std::vector<uint8_t>& data, bool swap) : mData(data), mSwap(swap) { }
+
+		uint16_t read16(size_t offset) const
+		{
+			uint16_t value;
+			std::memcpy(&value, mData.data() + offset, sizeof(value));
+			return mSwap ? static_cast<uint16_t>((value >> 8) | (value << 8)) : value;
+		}
+
+		uint32_t read32(size_t offset) const
+		{
+			uint32_t value;
+			std::memcpy(&value, mData.data() + offset, sizeof(value));
+			return mSwap ? ((value >> 24) | ((value >> 8) & 0xff00) | ((value << 8) & 0xff0000) | (value << 24)) : value;
+		}
+
+	private:
+		const std::vector<uint8_t>& mData;
+		bool mSwap;
+	};
+
+
+	// Reads a big endian integer from a network header
+	static uint16_t readNetwork16(const uint8_t* data)
+	{
+		return static_cast<uint16_t>((data[0] << 8) | data[1]);
+	}
+
+
+	static uint32_t readNetwork32(const uint8_t* data)
+	{
+		return (static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+	}
+
+
+	// Converts a timestamp in units of the given resolution to nanoseconds
+	static int64 toNanoseconds(uint64_t timestamp, uint64_t unitsPerSecond)
+	{
+		const uint64_t seconds = timestamp / unitsPerSecond;
+		const uint64_t fraction = timestamp % unitsPerSecond;
+		return static_cast<int64>(seconds * 1000000000ull + static_cast<uint64_t>(fraction * (1e9 / unitsPerSecond)));
+	}
+
+
+	VBANPcapReplayServer::~VBANPcapReplayServer()
+	{
+		if (mReplayThread != nullptr)
+			stop();
+	}
+
+
+	bool VBANPcapReplayServer::start(utility::ErrorState& errorState)
+	{
+		if (!errorState.check(mSpeed >= 0.f, "%s: Speed can't be negative", mID.c_str()))
+			return false;
+		if (!errorState.check(mPacketPoolSize > 0, "%s: PacketPoolSize must be greater than zero", mID.c_str()))
+			return false;
+
+		if (!load(errorState))
+			return false;
+		if (!errorState.check(!mRecords.empty(), "%s: %s contains no VBAN packets sent to port %i", mID.c_str(), mFile.c_str(), mPort))
+			return false;
+
+		// The pool outlives restarts of the server, listeners might still retain packets from a previous session
+		if (mReplayPool == nullptr)
+			mReplayPool = std::make_unique<VBANPacketPool>(mPacketPoolSize);
+
+		nap::Logger::info(*this, "Replaying %i packets from %s", static_cast<int>(mRecords.size()), mFile.c_str());
+		mFinished.store(false);
+		mReplayedPacketCount.store(0);
+		mReplaying.store(true);
+		mReplayThread = std::make_unique<std::thread>([this](){ replayLoop(); });
+		return true;
+	}
+
+
+	void VBANPcapReplayServer::stop()
+	{
+		mReplaying.store(false);
+		if (mReplayThread != nullptr)
+		{
+			mReplayThread->join();
+			mReplayThread = nullptr;
+		}
+	}
+
+
+	bool VBANPcapReplayServer::load(utility::ErrorState& errorState)
+	{
+		mRecords.clear();
+		mPayload.clear();
+
+		std::ifstream stream(mFile, std::ios::binary);
+		if (!errorState.check(stream.is_open(), "%s: Unable to open %s", mID.c_str(), mFile.c_str()))
+			return false;
+		std::vector<uint8_t> file((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+		if (!errorState.check(file.size() >= 24, "%s: %s is not a pcap or pcapng file", mID.c_str(), mFile.c_str()))
+			return false;
+
+		uint32_t magic;
+		std::memcpy(&magic, file.data(), sizeof(magic));
+		if (!(magic == 0x0A0D0D0A ? loadPcapNG(file, errorState) : loadPcap(file, errorState)))
+			return false;
+
+		// Replay in order of capture, captures from multiple interfaces are not necessarily ordered
+		std::stable_sort(mRecords.begin(), mRecords.end(), [](const Record& a, const Record& b) { return a.mTime < b.mTime; });
+		return true;
+	}
+
+
+	bool VBANPcapReplayServer::loadPcap(const std::vector<uint8_t>& file, utility::ErrorState& errorState)
+	{
+		uint32_t magic;
+		std::memcpy(&magic, file.data(), sizeof(magic));
+
+		bool swap = false;
+		uint64_t units_per_second = 1000000;
+		switch (magic)
+		{
+			case 0xa1b2c3d4: break;
+			case 0xd4c3b2a1: swap = true; break;
+			case 0xa1b23c4d: units_per_second = 1000000000; break;
+			case 0x4d3cb2a1: units_per_second = 1000000000; swap = true; break;
+			default:
+				errorState.fail("%s: %s is not a pcap or pcapng file", mID.c_str(), mFile.c_str());
+				return false;
+		}
+
+		CaptureReader reader(file, swap);
+		const int link_type = static_cast<int>(reader.read32(20) & 0xffff);
+
+		size_t offset = 24;
+		while (offset + 16 <= file.size())
+		{
+			const uint64_t seconds = reader.read32(offset);
+			const uint64_t fraction = reader.read32(offset + 4);
+			const size_t captured_size = reader.read32(offset + 8);
+			offset += 16;
+			if (offset + captured_size > file.size())
+			{
+				nap::Logger::warn(*this, "%s is truncated, replaying the complete packets only", mFile.c_str());
+				break;
+			}
+
+			addFrame(link_type, toNanoseconds(seconds * units_per_second + fraction, units_per_second), file.data() + offset, captured_size);
+			offset += captured_size;
+		}
+		return true;
+	}
+
+
+	bool VBANPcapReplayServer::loadPcapNG(const std::vector<uint8_t>& file, utility::ErrorState& errorState)
+	{
+		// Link type and timestamp resolution of every interface in the current section
+		struct Interface
+		{
+			int mLinkType = 0;
+			uint64_t mUnitsPerSecond = 1000000;
+		};
+		std::vector<Interface> interfaces;
+
+		bool swap = false;
+		int64 last_time = 0;
+		size_t offset = 0;
+		while (offset + 12 <= file.size())
+		{
+			// The byte order is defined per section by the magic in the section header block
+			uint32_t type;
+			std::memcpy(&type, file.data() + offset, sizeof(type));
+			if (type == 0x0A0D0D0A)
+			{
+				uint32_t byte_order_magic;
+				std::memcpy(&byte_order_magic, file.data() + offset + 8, sizeof(byte_order_magic));
+				if (!errorState.check(byte_order_magic == 0x1A2B3C4D || byte_order_magic == 0x4D3C2B1A, "%s: %s has an invalid pcapng section header", mID.c_str(), mFile.c_str()))
+					return false;
+				swap = byte_order_magic == 0x4D3C2B1A;
+				interfaces.clear();
+			}
+
+			CaptureReader reader(file, swap);
+			const size_t block_size = reader.read32(offset + 4);
+			if (block_size < 12 || offset + block_size > file.size())
+			{
+				nap::Logger::warn(*this, "%s is truncated, replaying the complete packets only", mFile.c_str());
+				break;
+			}
+
+			const size_t body = offset + 8;
+			const size_t body_end = offset + block_size - 4;
+			switch (reader.read32(offset))
+			{
+				// Interface description block
+				case 1:
+				{
+					if (body + 8 > body_end)
+						break;
+					Interface& description = interfaces.emplace_back();
+					description.mLinkType = reader.read16(body);
+
+					// Look for the timestamp resolution option
+					size_t option = body + 8;
+					while (option + 4 <= body_end)
+					{
+						const uint16_t code = reader.read16(option);
+						const uint16_t length = reader.read16(option + 2);
+						if (code == 0 || option + 4 + length > body_end)
+							break;
+						if (code == 9 && length >= 1)
+						{
+							const uint8_t resolution = file[option + 4];
+							const int exponent = resolution & 0x7f;
+							uint64_t units = 1;
+							for (auto i = 0; i < exponent && units < 1000000000000000000ull; ++i)
+								units *= (resolution & 0x80) != 0 ? 2 : 10;
+							description.mUnitsPerSecond = units;
+						}
+						option += 4 + ((length + 3) & ~3);
+					}
+					break;
+				}
+
+				// Enhanced packet block
+				case 6:
+				{
+					if (body + 20 > body_end)
+						break;
+					const uint32_t interface_id = reader.read32(body);
+					if (interface_id >= interfaces.size())
+						break;
+					const uint64_t timestamp = (static_cast<uint64_t>(reader.read32(body + 4)) << 32) | reader.read32(body + 8);
+					const size_t captured_size = std::min<size_t>(reader.read32(body + 12), body_end - (body + 20));
+					const auto& description = interfaces[interface_id];
+					last_time = toNanoseconds(timestamp, description.mUnitsPerSecond);
+					addFrame(description.mLinkType, last_time, file.data() + body + 20, captured_size);
+					break;
+				}
+
+				// Simple packet block, carries no timestamp and is replayed at the time of the previous packet
+				case 3:
+				{
+					if (body + 4 > body_end || interfaces.empty())
+						break;
+					const size_t captured_size = std::min<size_t>(reader.read32(body), body_end - (body + 4));
+					addFrame(interfaces.front().mLinkType, last_time, file.data() + body + 4, captured_size);
+					break;
+				}
+
+				default:
+					break;
+			}
+
+			offset += block_size;
+		}
+		return true;
+	}
+
+
+	void VBANPcapReplayServer::addFrame(int linkType, int64 time, const uint8_t* frame, size_t size)
+	{
+		// Strip the link layer header, only IPv4 is of interest
+		size_t ip_offset = 0;
+		switch (linkType)
+		{
+			case sLinkTypeEthernet:
+			{
+				ip_offset = 12;
+				while (ip_offset + 2 <= size && (readNetwork16(frame + ip_offset) == 0x8100 || readNetwork16(frame + ip_offset) == 0x88a8))
+					ip_offset += 4;
+				if (ip_offset + 2 > size || readNetwork16(frame + ip_offset) != 0x0800)
+					return;
+				ip_offset += 2;
+				break;
+			}
+			case sLinkTypeNull:
+			case sLinkTypeLoop:
+				ip_offset = 4;
+				break;
+			case sLinkTypeRaw:
+			case sLinkTypeIPv4:
+				ip_offset = 0;
+				break;
+			case sLinkTypeLinuxSLL:
+				if (size < 16 || readNetwork16(frame + 14) != 0x0800)
+					return;
+				ip_offset = 16;
+				break;
+			case sLinkTypeLinuxSLL2:
+				if (size < 20 || readNetwork16(frame) != 0x0800)
+					return;
+				ip_offset = 20;
+				break;
+			default:
+				return;
+		}
+
+		// IPv4 header, fragments are skipped
+		if (ip_offset + 20 > size)
+			return;
+		const uint8_t* ip = frame + ip_offset;
+		const size_t ip_header_size = (ip[0] & 0x0f) * 4;
+		if ((ip[0] >> 4) != 4 || ip_header_size < 20 || ip[9] != 17 || (readNetwork16(ip + 6) & 0x3fff) != 0)
+			return;
+
+		// UDP header
+		if (ip_offset + ip_header_size + 8 > size)
+			return;
+		const uint8_t* udp = ip + ip_header_size;
+		if (readNetwork16(udp + 2) != mPort)
+			return;
+		const size_t udp_size = readNetwork16(udp + 4);
+		if (udp_size < 8)
+			return;
+
+		// Only complete VBAN datagrams are replayed
+		const uint8_t* payload = udp + 8;
+		const size_t payload_size = udp_size - 8;
+		if (ip_offset + ip_header_size + udp_size > size || payload_size < VBAN_HEADER_SIZE || payload_size > VBAN_PROTOCOL_MAX_SIZE)
+			return;
+		if (std::memcmp(payload, "VBAN", 4) != 0)
+			return;
+
+		Record& record = mRecords.emplace_back();
+		record.mTime = time;
+		record.mSource = { readNetwork32(ip + 12), readNetwork16(udp) };
+		record.mOffset = mPayload.size();
+		record.mSize = payload_size;
+		mPayload.insert(mPayload.end(), payload, payload + payload_size);
+	}
+
+
+	void VBANPcapReplayServer::replayLoop()
+	{
+		const int batch_size = std::max(mBatchSize, 1);
+		const double speed = mSpeed;
+		const int64 first_time = mRecords.front().mTime;
+		const int64 duration = mRecords.back().mTime - first_time;
+
+		// When looping, the capture restarts one mean packet interval after its last packet
+		const int64 loop_duration = duration + (mRecords.size() > 1 ? duration / static_cast<int64>(mRecords.size() - 1) : 0);
+
+		const auto start = std::chrono::steady_clock::now();
+		const int64 start_timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		int64 loop_offset = 0;
+
+		// Time since the start of the replay at which a record is due, in nanoseconds of capture time
+		auto capture_elapsed = [&](const Record& record) { return record.mTime - first_time + loop_offset; };
+
+		std::vector<Packet*> batch(batch_size, nullptr);
+		size_t index = 0;
+		while (mReplaying.load())
+		{
+			if (index == mRecords.size())
+			{
+				if (!mLoop)
+				{
+					mFinished.store(true);
+					break;
+				}
+				index = 0;
+				loop_offset += loop_duration;
+			}
+
+			// Wait until the next record is due, in steps so the replay can be stopped
+			if (speed > 0.0)
+			{
+				const auto due = start + std::chrono::nanoseconds(static_cast<int64>(capture_elapsed(mRecords[index]) / speed));
+				const auto now = std::chrono::steady_clock::now();
+				if (now < due)
+				{
+					std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(due - now, std::chrono::milliseconds(100)));
+					continue;
+				}
+			}
+
+			// Gather all records that are due into a batch, like a batch of datagrams that queued up in the socket
+			int count = 0;
+			const auto now = std::chrono::steady_clock::now();
+			while (count < batch_size && index < mRecords.size())
+			{
+				const Record& record = mRecords[index];
+				const int64 elapsed = capture_elapsed(record);
+				if (speed > 0.0 && start + std::chrono::nanoseconds(static_cast<int64>(elapsed / speed)) > now)
+					break;
+
+				// The replay is never lossy, wait for listeners to return packets when the pool is exhausted
+				auto* packet = mReplayPool->acquire();
+				if (packet == nullptr)
+					break;
+
+				std::memcpy(packet->data(), mPayload.data() + record.mOffset, record.mSize);
+				packet->setSize(record.mSize);
+				packet->setSource(record.mSource);
+				packet->setTimestamp(start_timestamp + static_cast<int64>(elapsed / (speed > 0.0 ? speed : 1.0)));
+				batch[count++] = packet;
+				++index;
+			}
+
+			if (count == 0)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			packetsReceived(batch.data(), count);
+			mReplayedPacketCount.fetch_add(count);
+			for (auto i = 0; i < count; ++i)
+				batch[i]->release();
+		}
+	}
+
+}
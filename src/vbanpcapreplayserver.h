@@ -0,0 +1,79 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Local includes
+#include "vbanudpserver.h"
+
+// Std includes
+#include <thread>
+
+namespace nap
+{
+
+	/**
+	 * Stand-in for the VBANUDPServer that replays VBAN traffic from a pcap or pcapng capture instead of receiving from the network.
+	 * The captured UDP datagrams sent to 'Port' are handed to the listeners exactly like received packets,
+	 * so VBANReceivers and circular buffers are exercised as in production, without senders or a network.
+	 * Supports Ethernet, raw IP, BSD loopback and Linux cooked captures of IPv4 traffic. Fragmented datagrams are skipped.
+	 * Packets are timestamped with their replay time derived from the capture, so jitter statistics are reproducible at any speed.
+	 */
+	class NAPAPI VBANPcapReplayServer : public VBANUDPServer
+	{
+		RTTI_ENABLE(VBANUDPServer)
+
+	public:
+		VBANPcapReplayServer() = default;
+		~VBANPcapReplayServer() override;
+
+		std::string mFile;					///< Property: 'File' path to the pcap or pcapng capture to replay
+		float mSpeed = 1.f;					///< Property: 'Speed' replay speed relative to the capture, 0 replays as fast as possible
+		bool mLoop = false;					///< Property: 'Loop' restart the replay when the end of the capture is reached
+
+		// Inherited from Device
+		bool start(utility::ErrorState& errorState) override;
+		void stop() override;
+
+		/**
+		 * @return If all packets of the capture were replayed, never true when looping. Thread-Safe
+		 */
+		bool isFinished() const { return mFinished.load(); }
+
+		/**
+		 * @return The number of packets handed to the listeners since the server was started. Thread-Safe
+		 */
+		int64 getReplayedPacketCount() const { return mReplayedPacketCount.load(); }
+
+		/**
+		 * @return The number of VBAN datagrams found in the capture.
+		 */
+		int getCapturedPacketCount() const { return static_cast<int>(mRecords.size()); }
+
+	private:
+		// Captured datagram, the payload is stored in mPayload
+		struct Record
+		{
+			int64 mTime = 0;			// Capture time in nanoseconds
+			VBANEndpoint mSource;
+			size_t mOffset = 0;
+			size_t mSize = 0;
+		};
+
+		bool load(utility::ErrorState& errorState);
+		bool loadPcap(const std::vector<uint8_t>& file, utility::ErrorState& errorState);
+		bool loadPcapNG(const std::vector<uint8_t>& file, utility::ErrorState& errorState);
+		void addFrame(int linkType, int64 time, const uint8_t* frame, size_t size);
+		void replayLoop();
+
+		std::vector<Record> mRecords;
+		std::vector<uint8_t> mPayload;
+		std::unique_ptr<VBANPacketPool> mReplayPool;
+		std::unique_ptr<std::thread> mReplayThread;
+		std::atomic<bool> mReplaying = { false };
+		std::atomic<bool> mFinished = { false };
+		std::atomic<int64> mReplayedPacketCount = { 0 };
+	};
+
+}
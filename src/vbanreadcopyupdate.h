@@ -0,0 +1,119 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace nap
+{
+
+	/**
+	 * Holds an immutable object that is read from realtime threads and only occasionally replaced from a control thread.
+	 * Readers never block: entering and leaving a read section costs two atomic increments, regardless of what the writer is doing.
+	 * Writers publish a new version of the object and wait, on the writing thread, until no reader can still be using the previous version before destroying it.
+	 */
+	template <typename T>
+	class VBANReadCopyUpdate
+	{
+	public:
+		/**
+		 * Scoped read section, the object returned by get() is guaranteed to stay alive until the section is destroyed.
+		 */
+		class ReadSection
+		{
+		public:
+			ReadSection(const VBANReadCopyUpdate<T>& owner) : mOwner(owner)
+			{
+				mParity = mOwner.mEpoch.load() & 1;
+				mOwner.mReaders[mParity].fetch_add(1);
+				mObject = mOwner.mCurrent.load();
+			}
+
+			~ReadSection() { mOwner.mReaders[mParity].fetch_sub(1); }
+
+			ReadSection(const ReadSection&) = delete;
+			ReadSection& operator=(const ReadSection&) = delete;
+
+			const T* get() const { return mObject; }
+			const T* operator->() const { return mObject; }
+			const T& operator*() const { return *mObject; }
+
+		private:
+			const VBANReadCopyUpdate<T>& mOwner;
+			const T* mObject = nullptr;
+			int mParity = 0;
+		};
+
+		/**
+		 * Constructor
+		 * @param object The initial version of the object.
+		 */
+		VBANReadCopyUpdate(std::unique_ptr<T> object = std::make_unique<T>()) : mCurrent(object.release()) { }
+
+		~VBANReadCopyUpdate() { delete mCurrent.load(); }
+
+		VBANReadCopyUpdate(const VBANReadCopyUpdate&) = delete;
+		VBANReadCopyUpdate& operator=(const VBANReadCopyUpdate&) = delete;
+
+		/**
+		 * Copies the current version, lets the given function modify the copy and publishes the result.
+		 * Returns when no reader can access the previous version anymore. Blocks concurrent writers, never readers.
+		 * @param modifier Function that receives the copy to modify as T&.
+		 */
+		template <typename F>
+		void update(F&& modifier)
+		{
+			std::lock_guard<std::mutex> lock(mWriteMutex);
+			auto object = std::make_unique<T>(*mCurrent.load());
+			modifier(*object);
+			publish(std::move(object));
+		}
+
+		/**
+		 * Waits until all read sections that were entered before this call have been left.
+		 * Use this to defer destruction of data that was referenced by a previous version.
+		 */
+		void synchronize()
+		{
+			std::lock_guard<std::mutex> lock(mWriteMutex);
+			waitForReaders();
+		}
+
+		/**
+		 * @return The current version, only safe to use from the thread that performs the updates.
+		 */
+		const T& getWriterCopy() const { return *mCurrent.load(); }
+
+	private:
+		void publish(std::unique_ptr<T> object)
+		{
+			auto previous = mCurrent.exchange(object.release());
+			waitForReaders();
+			delete previous;
+		}
+
+		// Flips the epoch twice and waits for both reader counters to drain once.
+		// Readers that could have loaded the previous version have incremented one of the two counters before it was replaced.
+		void waitForReaders()
+		{
+			for (auto i = 0; i < 2; ++i)
+			{
+				auto parity = mEpoch.fetch_add(1) & 1;
+				while (mReaders[parity].load() > 0)
+					std::this_thread::yield();
+			}
+		}
+
+		std::atomic<T*> mCurrent;
+		mutable std::atomic<uint64_t> mEpoch = { 0 };
+		mutable std::atomic<int> mReaders[2] = { { 0 }, { 0 } };
+		std::mutex mWriteMutex;
+	};
+
+}
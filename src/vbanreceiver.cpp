@@ -1,17 +1,45 @@
 #include "vbanreceiver.h"
 
 #include <vbanutils.h>
+#include <vbandecode.h>
 #include <vban/vban.h>
 
+#include <nap/logger.h>
+
+RTTI_BEGIN_ENUM(nap::EVBANBufferLayout)
+	RTTI_ENUM_VALUE(nap::EVBANBufferLayout::Planar,			"Planar"),
+	RTTI_ENUM_VALUE(nap::EVBANBufferLayout::Interleaved,	"Interleaved")
+RTTI_END_ENUM
+
 RTTI_BEGIN_CLASS_NO_DEFAULT_CONSTRUCTOR(nap::VBANReceiver)
     RTTI_CONSTRUCTOR(nap::Core&)
 	RTTI_PROPERTY("Server", &nap::VBANReceiver::mServer, nap::rtti::EPropertyMetaData::Required)
+	RTTI_PROPERTY("RedundantServer", &nap::VBANReceiver::mRedundantServer, nap::rtti::EPropertyMetaData::Default)
 	RTTI_PROPERTY("CircularBufferSize", &nap::VBANReceiver::mCircularBufferSize, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("MaxStreamCount", &nap::VBANReceiver::mMaxStreamCount, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("BufferLayout", &nap::VBANReceiver::mBufferLayout, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("Latency", &nap::VBANReceiver::mLatency, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("AdaptiveLatency", &nap::VBANReceiver::mAdaptiveLatency, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("MinLatency", &nap::VBANReceiver::mMinLatency, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("MaxLatency", &nap::VBANReceiver::mMaxLatency, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("DriftCompensation", &nap::VBANReceiver::mDriftCompensation, nap::rtti::EPropertyMetaData::Default)
 RTTI_END_CLASS
 
 namespace nap
 {
 
+    // True when both servers receive the same packets: bound to the same port on overlapping addresses, or joined to the same multicast group on the same interface.
+    // With a ShardCount above 1 they would bind with SO_REUSEPORT and split the packets between them.
+    static bool receiveSamePackets(const VBANUDPServer& server, const VBANUDPServer& other)
+    {
+    	if (!server.mMulticastGroup.empty() || !other.mMulticastGroup.empty())
+    		return server.mMulticastGroup == other.mMulticastGroup && server.mMulticastInterface == other.mMulticastInterface;
+
+    	auto is_any = [](const std::string& address) { return address.empty() || address == "0.0.0.0"; };
+    	return server.mPort == other.mPort && (server.mIPAddress == other.mIPAddress || is_any(server.mIPAddress) || is_any(other.mIPAddress));
+    }
+
+
     VBANReceiver::VBANReceiver(Core &core)
     {
         mAudioService = core.getService<audio::AudioService>();
@@ -20,14 +48,47 @@ namespace nap
 
     bool VBANReceiver::init(utility::ErrorState &errorState)
     {
+    	if (!errorState.check(mMaxStreamCount > 0, "%s: MaxStreamCount must be greater than zero", mID.c_str()))
+    		return false;
+
+    	if (!errorState.check(mRedundantServer.get() != mServer.get(), "%s: RedundantServer must be another server than Server, receiving over another network interface", mID.c_str()))
+    		return false;
+
+    	if (!errorState.check(mRedundantServer == nullptr || !receiveSamePackets(*mServer, *mRedundantServer),
+    		"%s: RedundantServer must bind to another IP Address or Port than Server, or join its multicast group on another interface", mID.c_str()))
+    		return false;
+
+    	if (!errorState.check(mCircularBufferSize >= utility::VBAN_MAX_PACKET_FRAME_COUNT && mCircularBufferSize <= (1 << 24),
+    		"%s: CircularBufferSize must be between %i and %i", mID.c_str(), utility::VBAN_MAX_PACKET_FRAME_COUNT, 1 << 24))
+    		return false;
+
     	auto& nodeManager = mAudioService->getNodeManager();
-    	mCircularBuffer = nodeManager.makeSafe<VBANCircularBuffer>(nodeManager, mCircularBufferSize);
+    	mCircularBuffer = nodeManager.makeSafe<VBANCircularBuffer>(nodeManager, mCircularBufferSize, mMaxStreamCount, mBufferLayout);
+    	if (mCircularBuffer->getSize() != mCircularBufferSize)
+    		nap::Logger::info("%s: CircularBufferSize rounded up to %i", mID.c_str(), mCircularBuffer->getSize());
+
+    	// Configure the latency
+    	if (!errorState.check(mLatency >= 0, "%s: Latency can't be negative", mID.c_str()))
+    		return false;
+    	mCircularBuffer->setLatency(mLatency);
+    	if (mAdaptiveLatency)
+    	{
+    		if (!errorState.check(mMinLatency >= 0.f && mMaxLatency >= mMinLatency, "%s: MaxLatency must be at least MinLatency, which can't be negative", mID.c_str()))
+    			return false;
+    		if (!errorState.check(mMaxLatency * nodeManager.getSamplesPerMillisecond() < mCircularBuffer->getSize(), "%s: MaxLatency exceeds the CircularBufferSize", mID.c_str()))
+    			return false;
+    		mCircularBuffer->setAdaptiveLatency(true, mMinLatency, mMaxLatency);
+    	}
+    	if (mDriftCompensation)
+    		mCircularBuffer->setDriftCompensation(true);
 
     	// Register as root process
     	registerBufferProcess(mCircularBuffer.get());
 
-    	// Register with the VBANUDPServer
+    	// Register with the VBANUDPServer, and the redundant one
     	mServer->registerListenerSlot(mPacketReceivedSlot);
+    	if (mRedundantServer != nullptr)
+    		mRedundantServer->registerListenerSlot(mRedundantPacketReceivedSlot);
 
         return true;
     }
@@ -36,16 +97,23 @@ namespace nap
     void VBANReceiver::onDestroy()
     {
         mServer->removeListenerSlot(mPacketReceivedSlot);
+        if (mRedundantServer != nullptr)
+            mRedundantServer->removeListenerSlot(mRedundantPacketReceivedSlot);
     	unregisterBufferProcess(mCircularBuffer.get());
     }
 
 
     void VBANReceiver::packetReceived(const VBANUDPServer::Packet &packet)
     {
-		const VBanHeader *const header = (struct VBanHeader *)(&packet.data()[0]);
+		// Let the circular buffer convert, deinterleave and write
+		mCircularBuffer->write(packet, 0);
+    }
+
 
-		// Let the circular buffer convert, deinterleave and write directly
-		mCircularBuffer->write(*header, packet.size());
+    void VBANReceiver::redundantPacketReceived(const VBANUDPServer::Packet &packet)
+    {
+		// Written unless the copy from the other path arrived first
+		mCircularBuffer->write(packet, 1);
     }
 
 
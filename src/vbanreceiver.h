@@ -12,6 +12,8 @@ namespace nap
      * Receives incoming VBAN packets from a VBANUDPServer and writes their audio data into a VBANCircularBuffer.
      * The circular buffer can be grabbed and read from by VBANCircularBufferReader.
      * Also streams can be added and removed from the VBANCircularBuffer.
+     * Packets are decoded into the circular buffer on the receiving thread of the shard that received them, shards only contend when they write the same stream.
+     * With a redundant server the streams are received over two independent network paths, and merged per packet: the copy that arrives first is played.
      */
     class NAPAPI VBANReceiver : public Resource
     {
@@ -19,7 +21,15 @@ namespace nap
 
     public:
         ResourcePtr<VBANUDPServer> mServer = nullptr; ///< Property: 'Server' Pointer to the VBAN UDP server receiving the packets
-        int mCircularBufferSize = 8192; ///< Property: 'CircularBufferSize' Size of the circular buffer
+        ResourcePtr<VBANUDPServer> mRedundantServer = nullptr; ///< Property: 'RedundantServer' Optional second server receiving the same streams over another network interface, packets lost on one path are taken from the other
+        int mCircularBufferSize = 8192; ///< Property: 'CircularBufferSize' Size of the circular buffer in samples, rounded up to a power of two
+        int mMaxStreamCount = 64; ///< Property: 'MaxStreamCount' Maximum number of streams received, a stream with multiple allowed sources counts once for every source
+        EVBANBufferLayout mBufferLayout = EVBANBufferLayout::Planar; ///< Property: 'BufferLayout' Memory layout of the received audio, Interleaved writes packets as a whole which pays off for many channels
+        int mLatency = 2; ///< Property: 'Latency' Latency as a multiple of the audio buffer size, used when adaptive latency is disabled
+        bool mAdaptiveLatency = false; ///< Property: 'AdaptiveLatency' Adapt the latency to the measured arrival jitter and underruns instead of using 'Latency'
+        float mMinLatency = 2.f; ///< Property: 'MinLatency' Lower bound of the adaptive latency in milliseconds
+        float mMaxLatency = 100.f; ///< Property: 'MaxLatency' Upper bound of the adaptive latency in milliseconds, also the latency adapting starts from
+        bool mDriftCompensation = false; ///< Property: 'DriftCompensation' Resample the received audio to follow the clock of the sender instead of resetting the latency when it drifts
 
         /**
          * Constructor
@@ -36,6 +46,20 @@ namespace nap
          */
         audio::SafePtr<VBANCircularBuffer> getCircularBuffer() { return mCircularBuffer.get(); }
 
+        /**
+         * Sums the packet counters of all streams received, to monitor the receiver as a whole.
+         * Counters of streams that were removed are not included. Thread-Safe
+         * @param snapshot Receives the summed counters
+         */
+        void getReceiveStatistics(VBANReceiveStatistics::Snapshot& snapshot) const { mCircularBuffer->getReceiveStatistics(snapshot); }
+
+        /**
+         * Sums the packet counters of all streams received over a single network path, to monitor the paths of a redundant receiver separately. Thread-Safe
+         * @param redundant False for the path of the server, true for the path of the redundant server
+         * @param snapshot Receives the summed counters
+         */
+        void getPathStatistics(bool redundant, VBANReceiveStatistics::Snapshot& snapshot) const { mCircularBuffer->getPathStatistics(redundant ? 1 : 0, snapshot); }
+
     private:
         /**
          * Normally the VBANCircularBuffer process is registered as root process with the NodeManager.
@@ -59,6 +83,10 @@ namespace nap
         Slot<const VBANUDPServer::Packet&> mPacketReceivedSlot = { this, &VBANReceiver::packetReceived };
         void packetReceived(const VBANUDPServer::Packet& packet);
 
+        // Slot for receiving VBAN packets from the redundant VBANUDPServer
+        Slot<const VBANUDPServer::Packet&> mRedundantPacketReceivedSlot = { this, &VBANReceiver::redundantPacketReceived };
+        void redundantPacketReceived(const VBANUDPServer::Packet& packet);
+
         audio::SafeOwner<VBANCircularBuffer> mCircularBuffer; // The VBANCircularBuffer to write packet data into
         audio::AudioService* mAudioService = nullptr;
     };
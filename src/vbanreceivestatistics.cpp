@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vbanreceivestatistics.h"
+
+#include <algorithm>
+
+namespace nap
+{
+
+	bool VBANReceiveStatistics::isRestart(uint32_t packetCounter) const
+	{
+		if (!mStarted || packetCounter != 0 || mHighestPacketCounter == 0)
+			return false;
+
+		// A sequence that started after packet 0 within the window is still waiting for it
+		return mSequenceStart == 0 || mHighestPacketCounter >= static_cast<uint32_t>(sReorderWindow);
+	}
+
+
+	void VBANReceiveStatistics::addArrival(uint32_t packetCounter, size_t size, bool restart)
+	{
+		mPacketCount.fetch_add(1, std::memory_order_relaxed);
+		mByteCount.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+
+		// Signed distance to the highest packet, so the comparison survives the packet counter wrapping around
+		const auto distance = static_cast<int32_t>(packetCounter - mHighestPacketCounter);
+
+		// Copies within the window are duplicates, also copies of the first packet of a sequence arriving over a redundant path
+		if (mStarted && !restart && distance <= 0 && distance > -sReorderWindow && (mReceivedMask & (uint64_t(1) << -distance)) != 0)
+		{
+			mDuplicateCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		// The first packet and a restarting sender start a new sequence
+		if (!mStarted || restart)
+		{
+			mHighestPacketCounter = packetCounter;
+			mSequenceStart = packetCounter;
+			mReceivedMask = 1;
+			mStarted = true;
+			return;
+		}
+
+		if (distance > 0)
+		{
+			// Packets skipped by the counter are lost until they arrive
+			if (distance > 1)
+				mLostCount.fetch_add(distance - 1, std::memory_order_relaxed);
+			mReceivedMask = distance < sReorderWindow ? (mReceivedMask << distance) | 1 : 1;
+			mHighestPacketCounter = packetCounter;
+			return;
+		}
+
+		// Packets beyond the window can't be told from duplicates, and packets before the first packet of the sequence were never counted as lost
+		const int age = -distance;
+		if (age >= sReorderWindow || static_cast<int32_t>(packetCounter - mSequenceStart) < 0)
+		{
+			mStaleCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		mReceivedMask |= uint64_t(1) << age;
+
+		// Arrived after a later packet, it was counted as lost when that packet arrived.
+		// Only this thread writes the lost count, the check keeps it from going negative.
+		mReorderedCount.fetch_add(1, std::memory_order_relaxed);
+		const auto lost_count = mLostCount.load(std::memory_order_relaxed);
+		if (lost_count > 0)
+			mLostCount.store(lost_count - 1, std::memory_order_relaxed);
+	}
+
+
+	void VBANReceiveStatistics::getSnapshot(Snapshot& snapshot) const
+	{
+		snapshot.mPacketCount = mPacketCount.load(std::memory_order_relaxed);
+		snapshot.mByteCount = mByteCount.load(std::memory_order_relaxed);
+		snapshot.mLostCount = std::max<int64_t>(0, mLostCount.load(std::memory_order_relaxed));
+		snapshot.mReorderedCount = mReorderedCount.load(std::memory_order_relaxed);
+		snapshot.mDuplicateCount = mDuplicateCount.load(std::memory_order_relaxed);
+		snapshot.mStaleCount = mStaleCount.load(std::memory_order_relaxed);
+		snapshot.mLateCount = mLateCount.load(std::memory_order_relaxed);
+		snapshot.mOvertakeCount = 0;
+		snapshot.mResetCount = 0;
+	}
+
+
+	void VBANReceiveStatistics::Snapshot::add(const Snapshot& other)
+	{
+		mPacketCount += other.mPacketCount;
+		mByteCount += other.mByteCount;
+		mLostCount += other.mLostCount;
+		mReorderedCount += other.mReorderedCount;
+		mDuplicateCount += other.mDuplicateCount;
+		mStaleCount += other.mStaleCount;
+		mLateCount += other.mLateCount;
+		mOvertakeCount += other.mOvertakeCount;
+		mResetCount += other.mResetCount;
+	}
+
+}
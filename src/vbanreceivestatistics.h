@@ -0,0 +1,96 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Nap includes
+#include <utility/dllexport.h>
+
+namespace nap
+{
+
+	/**
+	 * Packet counters of a single VBAN stream, derived from the packet counters in the VBAN headers.
+	 * Updated from the receiving thread without allocating, formatting or logging, and read from any other thread without locking.
+	 * The counters only increase, rates are derived by comparing snapshots.
+	 */
+	class NAPAPI VBANReceiveStatistics
+	{
+	public:
+		static constexpr int sReorderWindow = 64;		///< Number of most recent packets that duplicates and reordered packets are recognized within
+
+		/**
+		 * Copy of the counters at a certain moment.
+		 */
+		struct Snapshot
+		{
+			int64_t mPacketCount = 0;			///< Number of packets received
+			int64_t mByteCount = 0;				///< Number of bytes received, including the VBAN headers
+			int64_t mLostCount = 0;				///< Number of packets skipped by the packet counter that did not arrive within sReorderWindow packets, never negative
+			int64_t mReorderedCount = 0;		///< Number of packets that arrived after a packet with a higher packet counter, within sReorderWindow packets
+			int64_t mDuplicateCount = 0;		///< Number of packets that arrived more than once
+			int64_t mStaleCount = 0;			///< Number of packets older than sReorderWindow packets or than the sequence, late packets and duplicates that can't be told apart
+			int64_t mLateCount = 0;				///< Number of packets that arrived after their audio was read
+			int64_t mOvertakeCount = 0;			///< Number of times the read position overtook the write position
+			int64_t mResetCount = 0;			///< Number of times the read position was reset, by configuration, restarting senders, overtaking or falling behind
+
+			/**
+			 * Adds the counters of another snapshot, to aggregate the statistics of multiple streams.
+			 * @param other The counters to add
+			 */
+			void add(const Snapshot& other);
+		};
+
+		/**
+		 * Registers the arrival of a packet, called from the receiving thread.
+		 * Packets older than sReorderWindow packets or than the sequence are counted as stale, they stay counted as lost.
+		 * @param packetCounter Packet counter from the VBAN header
+		 * @param size Size of the packet in bytes
+		 * @param restart True when the packet starts a new sequence, the sender restarted. See isRestart()
+		 */
+		void addArrival(uint32_t packetCounter, size_t size, bool restart);
+
+		/**
+		 * Tells whether a packet restarts the sequence of packets that arrive in order, as over a single network path. Called from the receiving thread.
+		 * Packet 0 restarts the sequence when it arrives after a higher packet counter,
+		 * unless packet 0 of the sequence did not arrive yet and the sequence is younger than sReorderWindow packets: then it was overtaken by its successors.
+		 * @param packetCounter Packet counter from the VBAN header
+		 * @return True when the sender restarted.
+		 */
+		bool isRestart(uint32_t packetCounter) const;
+
+		/**
+		 * Registers a packet that arrived after its audio was read, called from the receiving thread.
+		 */
+		void addLateArrival() { mLateCount.fetch_add(1, std::memory_order_relaxed); }
+
+		/**
+		 * Copies the counters of the receiving thread. Overtakes and resets are counted by the circular buffer. Thread-Safe
+		 * @param snapshot Receives the counters
+		 */
+		void getSnapshot(Snapshot& snapshot) const;
+
+	private:
+		// Only accessed by the receiving thread
+		uint32_t mHighestPacketCounter = 0;
+		uint32_t mSequenceStart = 0;			// Packet counter of the first packet of the sequence
+		uint64_t mReceivedMask = 0;				// Bit n is set when the packet n packets before the highest packet arrived
+		bool mStarted = false;
+
+		// Published to readers
+		std::atomic<int64_t> mPacketCount = { 0 };
+		std::atomic<int64_t> mByteCount = { 0 };
+		std::atomic<int64_t> mLostCount = { 0 };
+		std::atomic<int64_t> mReorderedCount = { 0 };
+		std::atomic<int64_t> mDuplicateCount = { 0 };
+		std::atomic<int64_t> mStaleCount = { 0 };
+		std::atomic<int64_t> mLateCount = { 0 };
+	};
+
+}
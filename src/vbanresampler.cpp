@@ -0,0 +1,327 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vbanresampler.h"
+
+#include <rtti/typeinfo.h>
+#include "vban/vban.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+	#define VBAN_RESAMPLER_SSE2
+	#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+	#define VBAN_RESAMPLER_NEON
+	#include <arm_neon.h>
+#endif
+
+RTTI_BEGIN_ENUM(nap::EVBANResamplerQuality)
+	RTTI_ENUM_VALUE(nap::EVBANResamplerQuality::Low,		"Low"),
+	RTTI_ENUM_VALUE(nap::EVBANResamplerQuality::Medium,		"Medium"),
+	RTTI_ENUM_VALUE(nap::EVBANResamplerQuality::High,		"High")
+RTTI_END_ENUM
+
+namespace nap
+{
+
+	static constexpr double sPi = 3.14159265358979323846;
+
+
+	// Filter design of a quality
+	struct FilterDesign
+	{
+		int mTapCount;			// Number of taps, a multiple of 8
+		double mCutoff;			// Cutoff of the sinc relative to the Nyquist frequency
+		double mKaiserBeta;		// Shape of the Kaiser window
+	};
+
+
+	static FilterDesign getFilterDesign(EVBANResamplerQuality quality)
+	{
+		switch (quality)
+		{
+		case EVBANResamplerQuality::Low:
+			return { 8, 0.8, 5.0 };
+		case EVBANResamplerQuality::Medium:
+			return { 16, 0.9, 6.5 };
+		default:
+			return { VBANResampler::sMaxTapCount, 0.95, 8.0 };
+		}
+	}
+
+
+	// Zeroth order modified Bessel function of the first kind, used by the Kaiser window
+	static double besselI0(double x)
+	{
+		double sum = 1.0;
+		double term = 1.0;
+		for (auto k = 1; k < 50 && term > sum * 1e-12; ++k)
+		{
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+
+	// Dot product of a frame of coefficients with the input, the tap count is a multiple of 8
+	static inline float convolve(const float* coefficients, const float* input, int tapCount)
+	{
+#if defined(VBAN_RESAMPLER_SSE2)
+		__m128 low = _mm_setzero_ps();
+		__m128 high = _mm_setzero_ps();
+		for (auto tap = 0; tap < tapCount; tap += 8)
+		{
+			low = _mm_add_ps(low, _mm_mul_ps(_mm_loadu_ps(coefficients + tap), _mm_loadu_ps(input + tap)));
+			high = _mm_add_ps(high, _mm_mul_ps(_mm_loadu_ps(coefficients + tap + 4), _mm_loadu_ps(input + tap + 4)));
+		}
+		__m128 sum = _mm_add_ps(low, high);
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		return _mm_cvtss_f32(sum);
+#elif defined(VBAN_RESAMPLER_NEON)
+		float32x4_t low = vdupq_n_f32(0.f);
+		float32x4_t high = vdupq_n_f32(0.f);
+		for (auto tap = 0; tap < tapCount; tap += 8)
+		{
+			low = vmlaq_f32(low, vld1q_f32(coefficients + tap), vld1q_f32(input + tap));
+			high = vmlaq_f32(high, vld1q_f32(coefficients + tap + 4), vld1q_f32(input + tap + 4));
+		}
+		float32x4_t sum = vaddq_f32(low, high);
+		float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+		return vget_lane_f32(vpadd_f32(pair, pair), 0);
+#else
+		// Independent lanes, so the compiler can vectorize it
+		constexpr int lane_count = 8;
+		float lanes[lane_count] = { };
+		for (auto tap = 0; tap < tapCount; tap += lane_count)
+			for (auto lane = 0; lane < lane_count; ++lane)
+				lanes[lane] += coefficients[tap + lane] * input[tap + lane];
+
+		float sum = 0.f;
+		for (auto lane = 0; lane < lane_count; ++lane)
+			sum += lanes[lane];
+		return sum;
+#endif
+	}
+
+
+	// Linear interpolation between two phases of the table, the tap count is a multiple of 8
+	static inline void interpolate(const float* first, const float* second, float weight, int tapCount, float* destination)
+	{
+#if defined(VBAN_RESAMPLER_SSE2)
+		const __m128 factor = _mm_set1_ps(weight);
+		for (auto tap = 0; tap < tapCount; tap += 4)
+		{
+			const __m128 a = _mm_loadu_ps(first + tap);
+			_mm_storeu_ps(destination + tap, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(second + tap), a), factor)));
+		}
+#elif defined(VBAN_RESAMPLER_NEON)
+		const float32x4_t factor = vdupq_n_f32(weight);
+		for (auto tap = 0; tap < tapCount; tap += 4)
+		{
+			const float32x4_t a = vld1q_f32(first + tap);
+			vst1q_f32(destination + tap, vmlaq_f32(a, vsubq_f32(vld1q_f32(second + tap), a), factor));
+		}
+#else
+		for (auto tap = 0; tap < tapCount; ++tap)
+			destination[tap] = first[tap] + (second[tap] - first[tap]) * weight;
+#endif
+	}
+
+
+	// Computes the Kaiser window of a filter design for every tap of every phase, shared by the tables of all ratios
+	static std::vector<double> buildWindow(const FilterDesign& design)
+	{
+		// One more phase than sPhaseCount, so the last phase can be interpolated towards the next input frame
+		const int tap_count = design.mTapCount;
+		const double history = tap_count / 2 - 1;
+		const double normalization = besselI0(design.mKaiserBeta);
+		std::vector<double> window((VBANResampler::sPhaseCount + 1) * tap_count);
+		for (auto phase = 0; phase <= VBANResampler::sPhaseCount; ++phase)
+		{
+			const double fraction = static_cast<double>(phase) / VBANResampler::sPhaseCount;
+			for (auto tap = 0; tap < tap_count; ++tap)
+			{
+				const double r = (tap - history - fraction) / (tap_count / 2);
+				window[phase * tap_count + tap] = besselI0(design.mKaiserBeta * std::sqrt(std::max(0.0, 1.0 - r * r))) / normalization;
+			}
+		}
+		return window;
+	}
+
+
+	// Computes the polyphase table of a filter design for a ratio
+	static void buildTable(const FilterDesign& design, const std::vector<double>& window, double ratio, std::vector<float>& table)
+	{
+		// Above a ratio of 1 the passband is narrowed to the Nyquist frequency of the output
+		const double cutoff = design.mCutoff / std::max(1.0, ratio);
+		const int tap_count = design.mTapCount;
+		const double history = tap_count / 2 - 1;
+		table.resize((VBANResampler::sPhaseCount + 1) * tap_count);
+		std::vector<double> coefficients(tap_count);
+		for (auto phase = 0; phase <= VBANResampler::sPhaseCount; ++phase)
+		{
+			const double fraction = static_cast<double>(phase) / VBANResampler::sPhaseCount;
+			double sum = 0.0;
+			for (auto tap = 0; tap < tap_count; ++tap)
+			{
+				const double x = tap - history - fraction;
+				const double sinc = x == 0.0 ? cutoff : std::sin(sPi * cutoff * x) / (sPi * x);
+				coefficients[tap] = sinc * window[phase * tap_count + tap];
+				sum += coefficients[tap];
+			}
+
+			// Unity gain at DC for every phase, so the level doesn't modulate with the phase
+			for (auto tap = 0; tap < tap_count; ++tap)
+				table[phase * tap_count + tap] = static_cast<float>(coefficients[tap] / sum);
+		}
+	}
+
+
+	VBANResampler::VBANResampler(EVBANResamplerQuality quality, float sampleRate) : mQuality(quality), mSampleRate(sampleRate)
+	{
+		updateTableSet();
+		setRatio(1.0);
+	}
+
+
+	void VBANResampler::setQuality(EVBANResamplerQuality quality)
+	{
+		if (quality == mQuality)
+			return;
+		mQuality = quality;
+		updateTableSet();
+	}
+
+
+	void VBANResampler::setSampleRate(float sampleRate)
+	{
+		if (sampleRate == mSampleRate)
+			return;
+		mSampleRate = sampleRate;
+		updateTableSet();
+	}
+
+
+	void VBANResampler::updateTableSet()
+	{
+		mPendingTableSet.store(&getTableSet(mQuality, mSampleRate), std::memory_order_release);
+	}
+
+
+	const VBANResampler::TableSet& VBANResampler::getTableSet(EVBANResamplerQuality quality, float sampleRate)
+	{
+		// Sets are only added, so a set stays valid while audio threads use it
+		static std::mutex mutex;
+		static std::map<std::pair<EVBANResamplerQuality, float>, std::unique_ptr<TableSet>> table_sets;
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& table_set = table_sets[{ quality, sampleRate }];
+		if (table_set != nullptr)
+			return *table_set;
+
+		// Ratio 1 and every VBAN sample rate above the output sample rate, lower sample rates share the table of ratio 1
+		std::vector<double> ratios = { 1.0 };
+		const auto output_sample_rate = static_cast<double>(static_cast<int>(sampleRate));
+		for (auto i = 0; i < VBAN_SR_MAXNUMBER; ++i)
+			if (VBanSRList[i] > output_sample_rate)
+				ratios.emplace_back(VBanSRList[i] / output_sample_rate);
+		std::sort(ratios.begin(), ratios.end());
+
+		table_set = std::make_unique<TableSet>();
+		const auto design = getFilterDesign(quality);
+		const auto window = buildWindow(design);
+		for (auto ratio : ratios)
+		{
+			auto& table = table_set->mTables.emplace_back();
+			table.mRatio = ratio;
+			table.mTapCount = design.mTapCount;
+			buildTable(design, window, ratio, table.mCoefficients);
+		}
+		return *table_set;
+	}
+
+
+	void VBANResampler::setRatio(double ratio)
+	{
+		// Pick up tables published by the control thread, the tap count only changes here so it is constant while processing
+		const auto& tables = mPendingTableSet.load(std::memory_order_acquire)->mTables;
+
+		// The table of the nearest ratio, all ratios up to 1 use the first table
+		const Table* nearest = &tables.front();
+		for (const auto& table : tables)
+			if (std::abs(table.mRatio - ratio) < std::abs(nearest->mRatio - ratio))
+				nearest = &table;
+		mTable = nearest;
+	}
+
+
+	void VBANResampler::reserve(int channelCount, int outputFrameCount, double maxStep)
+	{
+		// Sized for the largest filter, so changing the quality doesn't invalidate the reservation
+		const int input_frame_count = static_cast<int>(std::ceil(1.0 + std::max(outputFrameCount - 1, 0) * maxStep)) + sMaxTapCount;
+		mInput.resize(channelCount);
+		for (auto& input : mInput)
+			input.resize(input_frame_count);
+		mInputPointers.resize(channelCount);
+		for (auto channel = 0; channel < channelCount; ++channel)
+			mInputPointers[channel] = mInput[channel].data();
+		mCoefficients.resize(static_cast<size_t>(outputFrameCount) * sMaxTapCount);
+		mOffsets.resize(outputFrameCount);
+		mMaxOutputFrameCount = outputFrameCount;
+	}
+
+
+	int VBANResampler::getInputFrameCount(double phase, double step, int outputFrameCount) const
+	{
+		return static_cast<int>(std::floor(phase + (outputFrameCount - 1) * step)) + getTapCount();
+	}
+
+
+	float* const* VBANResampler::getInputBuffers(int channelCount, int frameCount)
+	{
+		if (channelCount > static_cast<int>(mInput.size()) || (channelCount > 0 && frameCount > static_cast<int>(mInput.front().size())))
+			return nullptr;
+		return mInputPointers.data();
+	}
+
+
+	void VBANResampler::process(const float* const* input, int channelCount, double phase, double step, int outputFrameCount, float* const* output)
+	{
+		if (outputFrameCount > mMaxOutputFrameCount)
+		{
+			for (auto channel = 0; channel < channelCount; ++channel)
+				std::fill(output[channel], output[channel] + outputFrameCount, 0.f);
+			return;
+		}
+
+		// Interpolate the coefficients of every output frame once for all channels
+		const int tap_count = getTapCount();
+		for (auto frame = 0; frame < outputFrameCount; ++frame)
+		{
+			const double position = phase + frame * step;
+			const double index = std::floor(position);
+			const double table_position = (position - index) * sPhaseCount;
+			const int row = std::min(static_cast<int>(table_position), sPhaseCount - 1);
+			const float* first = mTable->mCoefficients.data() + row * tap_count;
+			interpolate(first, first + tap_count, static_cast<float>(table_position - row), tap_count, mCoefficients.data() + frame * tap_count);
+			mOffsets[frame] = static_cast<int>(index);
+		}
+
+		// Channel by channel, so the input of a channel stays in cache
+		for (auto channel = 0; channel < channelCount; ++channel)
+		{
+			const float* source = input[channel];
+			float* destination = output[channel];
+			for (auto frame = 0; frame < outputFrameCount; ++frame)
+				destination[frame] = convolve(mCoefficients.data() + frame * tap_count, source + mOffsets[frame], tap_count);
+		}
+	}
+
+}
@@ -0,0 +1,163 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <atomic>
+#include <vector>
+
+// Nap includes
+#include <utility/dllexport.h>
+
+namespace nap
+{
+
+	/**
+	 * Trades the accuracy of a VBANResampler against the CPU time it takes per channel.
+	 * The error is measured on a 1 kHz sine converted from 44.1 kHz to 48 kHz, relative to the sine.
+	 */
+	enum class EVBANResamplerQuality : int
+	{
+		Low			= 0,	///< 8 taps, passband up to 80% of the Nyquist frequency, -61 dB of error, for many channels
+		Medium		= 1,	///< 16 taps, passband up to 90% of the Nyquist frequency, -72 dB of error
+		High		= 2		///< 32 taps, passband up to 95% of the Nyquist frequency, -85 dB of error
+	};
+
+
+	/**
+	 * Band-limited fractional resampler for planar audio, interpolates with a Kaiser windowed sinc of getTapCount() taps.
+	 * The filter is stored as a polyphase table of sPhaseCount phases, coefficients in between phases are interpolated linearly.
+	 * Coefficients are computed once per output frame and shared by all channels, so the cost per channel is a single dot product of getTapCount() contiguous samples.
+	 * The resampler keeps no history, the caller provides getTapCount() - 1 frames of context around the frames to interpolate, see getInputFrameCount().
+	 * The tables of every ratio between a VBAN sample rate and the engine's sample rate are built on the control thread by setQuality() and setSampleRate(),
+	 * and shared by all resamplers of the same quality and sample rate. The audio thread only selects a table.
+	 * Use one resampler per audio thread, only setQuality() and setSampleRate() may be called from another thread.
+	 */
+	class NAPAPI VBANResampler final
+	{
+	public:
+		static constexpr int sMaxTapCount = 32;			///< Number of filter taps at the highest quality
+		static constexpr int sPhaseCount = 256;			///< Number of phases in the polyphase table
+
+		/**
+		 * Builds or shares the tables of the quality and sample rate, building takes a few milliseconds.
+		 * @param quality the accuracy of the filter
+		 * @param sampleRate the sample rate audio is resampled to
+		 */
+		VBANResampler(EVBANResamplerQuality quality = EVBANResamplerQuality::High, float sampleRate = 48000.f);
+
+		/**
+		 * Switches to the tables of another quality, building them when no resampler used them before. Called from the control thread.
+		 * The audio thread picks the tables up on the next call to setRatio().
+		 * @param quality the accuracy of the filter
+		 */
+		void setQuality(EVBANResamplerQuality quality);
+
+		/**
+		 * @return the accuracy of the filter
+		 */
+		EVBANResamplerQuality getQuality() const { return mQuality; }
+
+		/**
+		 * Switches to the tables of another output sample rate, building them when no resampler used them before. Called from the control thread.
+		 * The audio thread picks the tables up on the next call to setRatio().
+		 * @param sampleRate the sample rate audio is resampled to
+		 */
+		void setSampleRate(float sampleRate);
+
+		/**
+		 * Selects the table for the nominal ratio of the input rate to the output rate, call before processing.
+		 * Above 1 the passband is narrowed to the Nyquist frequency of the output, so the input doesn't alias.
+		 * Ratios between a VBAN sample rate and the output sample rate have a table of their own, other ratios use the table of the nearest ratio.
+		 * Never allocates or builds a table.
+		 * @param ratio input rate divided by output rate
+		 */
+		void setRatio(double ratio);
+
+		/**
+		 * @return The number of filter taps of the selected table.
+		 */
+		int getTapCount() const { return mTable->mTapCount; }
+
+		/**
+		 * @return The number of input frames before the first interpolated input frame.
+		 */
+		int getHistoryFrameCount() const { return getTapCount() / 2 - 1; }
+
+		/**
+		 * Returns the number of input frames needed to compute the given number of output frames.
+		 * The first interpolated input frame is at index getHistoryFrameCount() of the input.
+		 * @param phase position of the first output frame between the first two interpolated input frames, between 0 and 1
+		 * @param step distance between output frames in input frames, 1 at equal sample rates
+		 * @param outputFrameCount number of output frames
+		 * @return the number of input frames needed
+		 */
+		int getInputFrameCount(double phase, double step, int outputFrameCount) const;
+
+		/**
+		 * Allocates the buffers for up to the given number of channels and output frames at any quality.
+		 * Call from the control thread before processing, getInputBuffers() and process() never allocate.
+		 * @param channelCount maximum number of channels
+		 * @param outputFrameCount maximum number of output frames per call to process()
+		 * @param maxStep maximum distance between output frames in input frames
+		 */
+		void reserve(int channelCount, int outputFrameCount, double maxStep);
+
+		/**
+		 * Returns planar input buffers of at least the given size, to fill before calling process().
+		 * @param channelCount number of channels
+		 * @param frameCount number of frames per channel
+		 * @return the input buffer of every channel, nullptr when the size exceeds what was reserved
+		 */
+		float* const* getInputBuffers(int channelCount, int frameCount);
+
+		/**
+		 * Interpolates output frames from the input.
+		 * Outputs silence when the number of output frames exceeds what was reserved.
+		 * @param input input frames of every channel, at least getInputFrameCount() frames each
+		 * @param channelCount number of channels
+		 * @param phase position of the first output frame between the first two interpolated input frames, between 0 and 1
+		 * @param step distance between output frames in input frames
+		 * @param outputFrameCount number of output frames
+		 * @param output receives the output frames of every channel
+		 */
+		void process(const float* const* input, int channelCount, double phase, double step, int outputFrameCount, float* const* output);
+
+	private:
+		// Polyphase filter of a single ratio
+		struct Table
+		{
+			double mRatio = 1.0;					// Input rate divided by output rate, 1 for all ratios up to 1
+			int mTapCount = sMaxTapCount;
+			std::vector<float> mCoefficients;		// sPhaseCount + 1 phases of mTapCount coefficients
+		};
+
+		// Tables of a quality for every ratio of a VBAN sample rate to an output sample rate, never destroyed once built
+		struct TableSet
+		{
+			std::vector<Table> mTables;				// Ordered by ratio, the first table is for ratio 1
+		};
+
+		// Returns the shared tables of a quality and sample rate, builds them on first use
+		static const TableSet& getTableSet(EVBANResamplerQuality quality, float sampleRate);
+
+		// Publishes the tables of the current quality and sample rate to the audio thread
+		void updateTableSet();
+
+		// Control thread
+		EVBANResamplerQuality mQuality = EVBANResamplerQuality::High;
+		float mSampleRate = 48000.f;
+		std::atomic<const TableSet*> mPendingTableSet = { nullptr };	// Tables setRatio() selects from
+
+		// Audio thread
+		const Table* mTable = nullptr;				// Table of the current ratio, selected by setRatio()
+		std::vector<float> mCoefficients;			// mTapCount coefficients for every output frame, sized by reserve()
+		std::vector<int> mOffsets;					// Index of the first input frame for every output frame, sized by reserve()
+		std::vector<std::vector<float>> mInput;		// Input buffers handed out by getInputBuffers(), sized by reserve()
+		std::vector<float*> mInputPointers;
+		int mMaxOutputFrameCount = 0;
+	};
+
+}
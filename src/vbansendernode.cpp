@@ -21,11 +21,10 @@ namespace nap
 	namespace audio
 	{
 
-		VBANSenderNode::VBANSenderNode(NodeManager& nodeManager, vban::SharedDirtyFlag& sharedDirtyFlag) : Node(nodeManager), mEncoder(*this, sharedDirtyFlag)
+		VBANSenderNode::VBANSenderNode(NodeManager& nodeManager) : Node(nodeManager), mEncoder(*this)
 		{
 			mInputPullResult.get().reserve(2);
 			sampleRateChanged(nodeManager.getSampleRate());
-			mEncoder.setActive(true);
 		}
 
 
@@ -36,18 +35,35 @@ namespace nap
 
 		void VBANSenderNode::process()
 		{
-			if (mUDPClient == nullptr)
+			if (mUDPClient == nullptr && mVBANClient == nullptr)
 				return;
 
 			// get output buffers
 			inputs.pull(mInputPullResult.get());
 
 			// Update channel count
-			auto channelCount = mInputPullResult.get().size();
+			auto channelCount = static_cast<int>(mInputPullResult.get().size());
+			if (channelCount == 0)
+				return;
 			if (channelCount != mEncoder.getChannelCount())
 				mEncoder.setChannelCount(channelCount);
 
-			mEncoder.process(mInputPullResult, channelCount, getBufferSize());
+			mEncoder.process(mInputPullResult, getBufferSize());
+		}
+
+
+		void VBANSenderNode::setStreamName(const std::string& name)
+		{
+			getNodeManager().enqueueTask([&, name](){ mEncoder.setStreamName(name); });
+		}
+
+
+		void VBANSenderNode::setSampleFormat(EVBANSampleFormat format)
+		{
+			getNodeManager().enqueueTask([&, format]()
+			{
+				mEncoder.setSampleFormat(format);
+			});
 		}
 
 
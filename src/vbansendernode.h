@@ -9,10 +9,11 @@
 
 // Vban includes
 #include <vban/vban.h>
-#include <vban/vbanstreamencoder.h>
 
 // Nap includes
 #include <udpclient.h>
+#include <vbanudpclient.h>
+#include <vbanencoder.h>
 
 // Audio includes
 #include <audio/core/audionode.h>
@@ -35,7 +36,7 @@ namespace nap
 			RTTI_ENABLE(Node)
 
 		public:
-			VBANSenderNode(NodeManager& nodeManager, vban::SharedDirtyFlag& sharedDirtyFlag);
+			VBANSenderNode(NodeManager& nodeManager);
 
 			virtual ~VBANSenderNode();
 
@@ -45,15 +46,39 @@ namespace nap
 			MultiInputPin inputs = {this};
 
 			void setUDPClient(UDPClient* client) { getNodeManager().enqueueTask([&, client](){ mUDPClient = client; }); }
-			void setStreamName(const std::string& name) { mEncoder.setStreamName(name); }
+			void setVBANClient(VBANUDPClient* client) { getNodeManager().enqueueTask([&, client](){ mVBANClient = client; }); }
+
+			/**
+			 * Sets a second VBAN client every packet is sent over as well, for a redundant network path.
+			 * Both clients send the same packets from a single encoder, so the receiver recognizes the copies by their packet counter.
+			 * @param client the redundant client, nullptr to send over a single path
+			 */
+			void setRedundantVBANClient(VBANUDPClient* client) { getNodeManager().enqueueTask([&, client](){ mRedundantVBANClient = client; }); }
+			void setStreamName(const std::string& name);
+
+			/**
+			 * Selects the sample format of the stream, 16 bit PCM by default.
+			 * @param format the sample format to send
+			 */
+			void setSampleFormat(EVBANSampleFormat format);
+
 			void sendPacket(const std::vector<char>& data)
 			{
+				// The VBAN client queues without allocating and can send to a multicast group
+				if (mVBANClient != nullptr)
+				{
+					mVBANClient->send(data.data(), data.size());
+					if (mRedundantVBANClient != nullptr)
+						mRedundantVBANClient->send(data.data(), data.size());
+					return;
+				}
+
 				UDPPacket packet(reinterpret_cast<const std::vector<uint8>&>(data));
 				mUDPClient->send(std::move(packet));
 			}
 
 		private:
-			// Wraps result of MultiInputPin::pull so that it can be passed to VBANStreamEncoder.
+			// Wraps result of MultiInputPin::pull so that it can be passed to VBANEncoder.
 			class PullResultWrapper
 			{
 			public:
@@ -71,7 +96,9 @@ namespace nap
 			void sampleRateChanged(float) override;
 
 			UDPClient* mUDPClient = nullptr;
-			vban::VBANStreamEncoder<VBANSenderNode> mEncoder;
+			VBANUDPClient* mVBANClient = nullptr;
+			VBANUDPClient* mRedundantVBANClient = nullptr;
+			VBANEncoder<VBANSenderNode> mEncoder;
 			PullResultWrapper mInputPullResult;
 			std::vector<nap::uint8> mData;
 		};
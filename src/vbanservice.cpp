@@ -0,0 +1,20 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vbanservice.h"
+#include "vbaneventqueue.h"
+
+RTTI_BEGIN_CLASS_NO_DEFAULT_CONSTRUCTOR(nap::VBANService)
+	RTTI_CONSTRUCTOR(nap::ServiceConfiguration*)
+RTTI_END_CLASS
+
+namespace nap
+{
+
+	void VBANService::update(double deltaTime)
+	{
+		VBANEventQueue::logAll();
+	}
+
+}
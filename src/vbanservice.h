@@ -0,0 +1,31 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Nap includes
+#include <nap/service.h>
+
+namespace nap
+{
+
+	/**
+	 * Logs the events that the receiving and audio threads of the VBAN module post to their VBANEventQueue, on the main thread.
+	 */
+	class NAPAPI VBANService : public Service
+	{
+		RTTI_ENABLE(Service)
+
+	public:
+		VBANService(ServiceConfiguration* configuration) : Service(configuration) { }
+
+	protected:
+		/**
+		 * Logs the queued events of all event queues.
+		 * @param deltaTime time since last update
+		 */
+		void update(double deltaTime) override;
+	};
+
+}
@@ -0,0 +1,103 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Third party includes
+#include <vban/vban.h>
+
+namespace nap
+{
+
+	/**
+	 * IPv4 address and port of a VBAN sender, both in host byte order.
+	 * When used as a filter a zero address or port matches any address or port.
+	 */
+	struct VBANEndpoint
+	{
+		uint32_t mAddress = 0;	///< IPv4 address, 0 matches any address
+		uint16_t mPort = 0;		///< Port, 0 matches any port
+
+		bool operator==(const VBANEndpoint& other) const { return mAddress == other.mAddress && mPort == other.mPort; }
+		bool operator!=(const VBANEndpoint& other) const { return !(*this == other); }
+
+		/**
+		 * @return This endpoint with the port replaced by the wildcard.
+		 */
+		VBANEndpoint anyPort() const { return { mAddress, 0 }; }
+	};
+
+
+	/**
+	 * Identifies a VBAN stream by its 16 byte stream name and the endpoint it is sent from.
+	 * The name is stored zero padded at fixed size, so keys can be built from packet headers without allocating.
+	 */
+	struct VBANStreamKey
+	{
+		VBANStreamKey() = default;
+
+		/**
+		 * @param name Stream name, at most VBAN_STREAM_NAME_SIZE characters and not necessarily null terminated.
+		 * @param source Endpoint of the sender.
+		 */
+		VBANStreamKey(const char* name, const VBANEndpoint& source) : mSource(source)
+		{
+			std::memcpy(mName.data(), name, strnlen(name, VBAN_STREAM_NAME_SIZE));
+		}
+
+		/**
+		 * @param name Stream name, truncated to VBAN_STREAM_NAME_SIZE characters.
+		 * @param source Endpoint of the sender.
+		 */
+		VBANStreamKey(const std::string& name, const VBANEndpoint& source) : VBANStreamKey(name.c_str(), source) { }
+
+		/**
+		 * Compares the names as two 64 bit words and the endpoints.
+		 */
+		bool operator==(const VBANStreamKey& other) const
+		{
+			uint64_t words[2], other_words[2];
+			std::memcpy(words, mName.data(), sizeof(words));
+			std::memcpy(other_words, other.mName.data(), sizeof(other_words));
+			return ((words[0] ^ other_words[0]) | (words[1] ^ other_words[1])) == 0 && mSource == other.mSource;
+		}
+
+		bool operator!=(const VBANStreamKey& other) const { return !(*this == other); }
+
+		/**
+		 * @return The stream name as string.
+		 */
+		std::string getName() const { return std::string(mName.data(), strnlen(mName.data(), VBAN_STREAM_NAME_SIZE)); }
+
+		static_assert(VBAN_STREAM_NAME_SIZE == 2 * sizeof(uint64_t), "Stream names are compared as two 64 bit words");
+		std::array<char, VBAN_STREAM_NAME_SIZE> mName = {};	///< Zero padded stream name
+		VBANEndpoint mSource;								///< Sender endpoint
+	};
+
+
+	/**
+	 * Hashes a VBANStreamKey, mixes the name and endpoint as 64 bit words.
+	 */
+	struct VBANStreamKeyHash
+	{
+		size_t operator()(const VBANStreamKey& key) const
+		{
+			uint64_t words[2];
+			std::memcpy(words, key.mName.data(), sizeof(words));
+			uint64_t hash = words[0] ^ (words[1] * 0x9e3779b97f4a7c15ull) ^ ((static_cast<uint64_t>(key.mSource.mAddress) << 16) | key.mSource.mPort);
+
+			// Final mix of splitmix64
+			hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+			hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+			return static_cast<size_t>(hash ^ (hash >> 31));
+		}
+	};
+
+}
@@ -18,6 +18,10 @@ RTTI_BEGIN_CLASS(nap::audio::VBANStreamPlayerComponent)
 		RTTI_PROPERTY("VBANPacketReceiver", &nap::audio::VBANStreamPlayerComponent::mVBANPacketReceiver, nap::rtti::EPropertyMetaData::Required)
 		RTTI_PROPERTY("ChannelRouting", &nap::audio::VBANStreamPlayerComponent::mChannelRouting, nap::rtti::EPropertyMetaData::Default)
 		RTTI_PROPERTY("StreamName", &nap::audio::VBANStreamPlayerComponent::mStreamName, nap::rtti::EPropertyMetaData::Default)
+		RTTI_PROPERTY("AllowedSources", &nap::audio::VBANStreamPlayerComponent::mAllowedSources, nap::rtti::EPropertyMetaData::Default)
+		RTTI_PROPERTY("Concealment", &nap::audio::VBANStreamPlayerComponent::mConcealment, nap::rtti::EPropertyMetaData::Default)
+		RTTI_PROPERTY("ResamplerQuality", &nap::audio::VBANStreamPlayerComponent::mResamplerQuality, nap::rtti::EPropertyMetaData::Default)
+		RTTI_PROPERTY("SyncGroup", &nap::audio::VBANStreamPlayerComponent::mSyncGroup, nap::rtti::EPropertyMetaData::Default)
 RTTI_END_CLASS
 
 RTTI_BEGIN_CLASS_NO_DEFAULT_CONSTRUCTOR(nap::audio::VBANStreamPlayerComponentInstance)
@@ -31,7 +35,7 @@ namespace nap
 	{
 		void VBANStreamPlayerComponentInstance::onDestroy()
 		{
-			mCircularBuffer->removeStream(mStreamName);
+			mCircularBuffer->removeStream(mStreamName, mAllowedSources);
 		}
 
 
@@ -42,18 +46,30 @@ namespace nap
 			mCircularBuffer = resource->mVBANPacketReceiver->getCircularBuffer();
 			mStreamName = resource->mStreamName;
 
+			// Parse the senders the stream is accepted from
+			for (auto& source : resource->mAllowedSources)
+			{
+				VBANEndpoint endpoint;
+				if (!errorState.check(utility::getVBANEndpointFromString(endpoint, source), "%s: Invalid allowed source %s, expected address or address:port", resource->mID.c_str(), source.c_str()))
+					return false;
+				mAllowedSources.emplace_back(endpoint);
+			}
+
 			// acquire audio service
 			mAudioService = getEntityInstance()->getCore()->getService<AudioService>();
 
 			mNodeManager = &mAudioService->getNodeManager();
 			mChannelRouting = resource->mChannelRouting;
 
-            // create buffer player for each channel
-			mReader = mNodeManager->makeSafe<VBANCircularBufferReader>(*mNodeManager);
-			mReader->init(mCircularBuffer, mStreamName, mChannelRouting.size());
-
             // register to the packet receiver
-            mCircularBuffer->addStream(mStreamName, mChannelRouting.size());
+            if (!errorState.check(mCircularBuffer->addStream(mStreamName, mChannelRouting.size(), mAllowedSources, resource->mSyncGroup), "%s: Unable to receive stream %s, see log for details", resource->mID.c_str(), mStreamName.c_str()))
+				return false;
+
+            // create buffer player for each channel, reading from the stream that was just added
+			mReader = mNodeManager->makeSafe<VBANCircularBufferReader>(*mNodeManager);
+			mReader->init(mCircularBuffer, mStreamName, mChannelRouting.size(), mAllowedSources);
+			mReader->setConcealment(resource->mConcealment);
+			mReader->setResamplerQuality(resource->mResamplerQuality);
 
 			return true;
 		}
@@ -26,7 +26,8 @@ namespace nap
 
 		/**
 		 * VBANStreamPlayerComponent hooks up to a VBANReceiver and plays incoming VBAN packets.
-		 * The VBAN packets must be configured to have the same samplerate and amount of channels as channels created in channel routing
+		 * The VBAN packets must be configured to have the same amount of channels as channels created in channel routing.
+		 * Streams at another samplerate than the audio engine are converted, with the accuracy set by the resampler quality.
 		 */
 		class NAPAPI VBANStreamPlayerComponent : public AudioComponentBase
 		{
@@ -48,6 +49,10 @@ namespace nap
 			ResourcePtr<VBANReceiver> mVBANPacketReceiver = nullptr; ///< Property: "VBANPacketReceiver" the packet receiver
 			std::vector<int> mChannelRouting = { }; ///< Property: "ChannelRouting" the channel routing, must be equal to excpected channels from stream
 			std::string mStreamName; ///< Property: "StreamName" the VBAN stream to listen to
+			std::vector<std::string> mAllowedSources; ///< Property: "AllowedSources" senders the stream is accepted from as "address" or "address:port", left empty accepts any sender
+			EVBANConcealment mConcealment = EVBANConcealment::Silence; ///< Property: "Concealment" how the audio of lost or late packets is replaced
+			EVBANResamplerQuality mResamplerQuality = EVBANResamplerQuality::High; ///< Property: "ResamplerQuality" accuracy of the samplerate conversion and drift compensation, lower qualities take less CPU per channel
+			std::string mSyncGroup; ///< Property: "SyncGroup" streams of the same receiver with the same sync group play back sample-aligned, left empty plays back independently of other streams
 		public:
 		};
 
@@ -83,10 +88,41 @@ namespace nap
 			 */
 			void setStreamName(const std::string& streamName){ mStreamName = streamName; }
 
+			/**
+			 * Copies the inter-arrival jitter statistics of the received stream.
+			 * Use these to choose the circular buffer size and latency.
+			 * @param snapshot Receives the statistics
+			 * @return False when the stream is not registered with the receiver.
+			 */
+			bool getJitterStatistics(VBANJitterStatistics::Snapshot& snapshot) const { return mCircularBuffer->getJitterStatistics(VBANCircularBuffer::getStreamKey(mStreamName, mAllowedSources), snapshot); }
+
+			/**
+			 * Copies the packet counters of the received stream: packets, bytes, lost, reordered, duplicate, stale and late packets, overtakes and resets.
+			 * @param snapshot Receives the counters
+			 * @return False when the stream is not registered with the receiver.
+			 */
+			bool getReceiveStatistics(VBANReceiveStatistics::Snapshot& snapshot) const { return mCircularBuffer->getReceiveStatistics(VBANCircularBuffer::getStreamKey(mStreamName, mAllowedSources), snapshot); }
+
+			/**
+			 * Copies the packet counters of the stream over a single network path of a receiver with a redundant server.
+			 * @param redundant False for the path of the server, true for the path of the redundant server
+			 * @param snapshot Receives the counters
+			 * @return False when the stream is not registered with the receiver.
+			 */
+			bool getPathStatistics(bool redundant, VBANReceiveStatistics::Snapshot& snapshot) const { return mCircularBuffer->getPathStatistics(VBANCircularBuffer::getStreamKey(mStreamName, mAllowedSources), redundant ? 1 : 0, snapshot); }
+
+			/**
+			 * Copies the state of the timeline the stream is read from, shared with the streams in the same sync group.
+			 * @param status Receives the latency, read rate and underrun count of the timeline
+			 * @return False when the stream is not registered with the receiver.
+			 */
+			bool getTimelineStatus(VBANCircularBuffer::TimelineStatus& status) const { return mCircularBuffer->getTimelineStatus(VBANCircularBuffer::getStreamKey(mStreamName, mAllowedSources), status); }
+
 		private:
 			SafeOwner<VBANCircularBufferReader> mReader;
 			std::vector<int> mChannelRouting;
 			std::string mStreamName;
+			std::vector<VBANEndpoint> mAllowedSources;
 
 			// VBANStreamPlayerComponent* mResource = nullptr; // The component's resource
 			NodeManager* mNodeManager = nullptr; // The audio node manager this component's audio nodes are managed by
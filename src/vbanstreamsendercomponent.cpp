@@ -13,9 +13,12 @@
 #include <audio/node/outputnode.h>
 
 RTTI_BEGIN_CLASS(nap::audio::VBANStreamSenderComponent)
-RTTI_PROPERTY("UdpClient", &nap::audio::VBANStreamSenderComponent::mUdpClient, nap::rtti::EPropertyMetaData::Required)
+RTTI_PROPERTY("UdpClient", &nap::audio::VBANStreamSenderComponent::mUdpClient, nap::rtti::EPropertyMetaData::Default)
+RTTI_PROPERTY("VBANClient", &nap::audio::VBANStreamSenderComponent::mVBANClient, nap::rtti::EPropertyMetaData::Default)
+RTTI_PROPERTY("RedundantVBANClient", &nap::audio::VBANStreamSenderComponent::mRedundantVBANClient, nap::rtti::EPropertyMetaData::Default)
 RTTI_PROPERTY("Input", &nap::audio::VBANStreamSenderComponent::mInput, nap::rtti::EPropertyMetaData::Required)
 RTTI_PROPERTY("StreamName", &nap::audio::VBANStreamSenderComponent::mStreamName, nap::rtti::EPropertyMetaData::Default)
+RTTI_PROPERTY("SampleFormat", &nap::audio::VBANStreamSenderComponent::mSampleFormat, nap::rtti::EPropertyMetaData::Default)
 RTTI_END_CLASS
 
 RTTI_BEGIN_CLASS_NO_DEFAULT_CONSTRUCTOR(nap::audio::VBANStreamSenderComponentInstance)
@@ -30,6 +33,8 @@ namespace nap
 	void VBANStreamSenderComponentInstance::onDestroy()
 	{
 		mVBANSenderNode->setUDPClient(nullptr);
+		mVBANSenderNode->setVBANClient(nullptr);
+		mVBANSenderNode->setRedundantVBANClient(nullptr);
 		mNodeManager->unregisterRootProcess(mVBANSenderNode.get());
 	}
 
@@ -44,6 +49,17 @@ namespace nap
 		auto* resource = getComponent<VBANStreamSenderComponent>();
 		auto& channelRouting = resource->mChannelRouting;
 
+		// Packets are sent by either the UDP client or the VBAN client
+		if (!errorState.check((resource->mUdpClient != nullptr) != (resource->mVBANClient != nullptr), "%s: Either UdpClient or VBANClient has to be set.", resource->mID.c_str()))
+			return false;
+		if (resource->mRedundantVBANClient != nullptr)
+		{
+			if (!errorState.check(resource->mVBANClient != nullptr, "%s: RedundantVBANClient requires VBANClient to be set.", resource->mID.c_str()))
+				return false;
+			if (!errorState.check(resource->mRedundantVBANClient.get() != resource->mVBANClient.get(), "%s: RedundantVBANClient must be another client than VBANClient, sending over another network interface", resource->mID.c_str()))
+				return false;
+		}
+
 		// configure channel routing
 		if (channelRouting.empty())
 		{
@@ -60,9 +76,12 @@ namespace nap
 		}
 
 		// Create the VBAN sender node
-		mVBANSenderNode = mNodeManager->makeSafe<VBANSenderNode>(*mNodeManager, resource->getSharedDirtyFlag());
+		mVBANSenderNode = mNodeManager->makeSafe<VBANSenderNode>(*mNodeManager);
 		mVBANSenderNode->setStreamName(resource->mStreamName);
+		mVBANSenderNode->setSampleFormat(resource->mSampleFormat);
 		mVBANSenderNode->setUDPClient(resource->mUdpClient.get());
+		mVBANSenderNode->setVBANClient(resource->mVBANClient.get());
+		mVBANSenderNode->setRedundantVBANClient(resource->mRedundantVBANClient.get());
 
 		// Connect outputs to VBAN sender node
 		for (auto channel = 0; channel < channelRouting.size(); ++channel)
@@ -6,8 +6,7 @@
 
 #include "udpclient.h"
 #include "vbansendernode.h"
-
-#include <vban/dirtyflag.h>
+#include "vbanudpclient.h"
 
 // Nap includes
 #include <nap/resourceptr.h>
@@ -38,14 +37,12 @@ namespace nap
 		public:
 			// Properties
 			ResourcePtr<UDPClient> mUdpClient = nullptr; ///< property: 'UDPClient' The udpclient that sends the VBAN packets
+			ResourcePtr<VBANUDPClient> mVBANClient = nullptr; ///< property: 'VBANClient' Sends the VBAN packets instead of the UDPClient, supports multicast
+			ResourcePtr<VBANUDPClient> mRedundantVBANClient = nullptr; ///< property: 'RedundantVBANClient' Optional second client sending the same packets over another network interface, requires VBANClient
 			std::string mStreamName			  = "localhost"; ///< property: 'StreamName' The streamname of the VBAN stream
 			nap::ComponentPtr<audio::AudioComponentBase> mInput; ///< property: 'Input' The component whose audio output will be send
 			std::vector<int> mChannelRouting; ///< property: 'ChannelRouting' The component whose audio output will be send
-
-			vban::SharedDirtyFlag& getSharedDirtyFlag() { return mSharedDirtyFlag; }
-
-		private:
-			vban::SharedDirtyFlag mSharedDirtyFlag;
+			EVBANSampleFormat mSampleFormat = EVBANSampleFormat::Int16; ///< property: 'SampleFormat' Sample format of the stream, Float32 sends without conversion
 		};
 
 		/**
@@ -0,0 +1,150 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <algorithm>
+#include <vector>
+
+// Local includes
+#include "vbanstreamkey.h"
+
+namespace nap
+{
+
+	/**
+	 * Fixed capacity hash table that maps VBAN stream keys to values, using open addressing with linear probing.
+	 * All memory is allocated on construction, lookups never allocate and compare keys as a few machine words.
+	 * The table is kept at most half full, so probe sequences stay short.
+	 * Not thread-safe, lookups can run concurrently with each other but not with insert() or erase().
+	 */
+	template<typename T>
+	class VBANStreamTable final
+	{
+	public:
+		/**
+		 * @param maxSize Maximum number of entries the table can hold
+		 */
+		explicit VBANStreamTable(int maxSize) : mMaxSize(std::max(maxSize, 1))
+		{
+			size_t capacity = 1;
+			while (capacity < static_cast<size_t>(mMaxSize) * 2)
+				capacity <<= 1;
+			mSlots.resize(capacity);
+			mMask = capacity - 1;
+		}
+
+		/**
+		 * Adds an entry.
+		 * @param key Key of the entry
+		 * @param value Value of the entry
+		 * @return False when the key is already present or the table is full.
+		 */
+		bool insert(const VBANStreamKey& key, T value)
+		{
+			if (mSize >= mMaxSize)
+				return false;
+
+			size_t index = VBANStreamKeyHash()(key) & mMask;
+			for (; mSlots[index].mOccupied; index = (index + 1) & mMask)
+			{
+				if (mSlots[index].mKey == key)
+					return false;
+			}
+
+			mSlots[index].mKey = key;
+			mSlots[index].mValue = std::move(value);
+			mSlots[index].mOccupied = true;
+			++mSize;
+			return true;
+		}
+
+		/**
+		 * Removes an entry.
+		 * @param key Key of the entry
+		 * @return False when the key was not present.
+		 */
+		bool erase(const VBANStreamKey& key)
+		{
+			size_t index = findIndex(key);
+			if (index == sNotFound)
+				return false;
+
+			// Shift back entries that probed past the removed slot, so no tombstones are needed
+			size_t next = (index + 1) & mMask;
+			while (mSlots[next].mOccupied)
+			{
+				const size_t home = VBANStreamKeyHash()(mSlots[next].mKey) & mMask;
+				if (((next - home) & mMask) >= ((next - index) & mMask))
+				{
+					mSlots[index] = std::move(mSlots[next]);
+					index = next;
+				}
+				next = (next + 1) & mMask;
+			}
+
+			mSlots[index].mOccupied = false;
+			mSlots[index].mValue = T();
+			--mSize;
+			return true;
+		}
+
+		/**
+		 * @param key Key of the entry
+		 * @return The value of the entry, nullptr when the key is not present.
+		 */
+		T* find(const VBANStreamKey& key)
+		{
+			size_t index = findIndex(key);
+			return index == sNotFound ? nullptr : &mSlots[index].mValue;
+		}
+
+		/**
+		 * @param key Key of the entry
+		 * @return The value of the entry, nullptr when the key is not present.
+		 */
+		const T* find(const VBANStreamKey& key) const
+		{
+			size_t index = findIndex(key);
+			return index == sNotFound ? nullptr : &mSlots[index].mValue;
+		}
+
+		/**
+		 * @return The number of entries in the table.
+		 */
+		int getSize() const { return mSize; }
+
+		/**
+		 * @return The maximum number of entries in the table.
+		 */
+		int getMaxSize() const { return mMaxSize; }
+
+	private:
+		struct Slot
+		{
+			VBANStreamKey mKey;
+			T mValue = T();
+			bool mOccupied = false;
+		};
+
+		static constexpr size_t sNotFound = ~size_t(0);
+
+		size_t findIndex(const VBANStreamKey& key) const
+		{
+			for (size_t index = VBANStreamKeyHash()(key) & mMask; mSlots[index].mOccupied; index = (index + 1) & mMask)
+			{
+				if (mSlots[index].mKey == key)
+					return index;
+			}
+			return sNotFound;
+		}
+
+		std::vector<Slot> mSlots;
+		size_t mMask = 0;
+		int mSize = 0;
+		int mMaxSize = 0;
+	};
+
+}
@@ -0,0 +1,186 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vbanudpclient.h"
+
+// ASIO Includes
+#include <asio/ip/udp.hpp>
+#include <asio/ip/multicast.hpp>
+#include <asio/ts/buffer.hpp>
+#include <asio/ts/internet.hpp>
+#include <asio/io_service.hpp>
+
+#include <chrono>
+#include <cstring>
+
+RTTI_BEGIN_CLASS(nap::VBANUDPClient)
+	RTTI_PROPERTY("Endpoint", &nap::VBANUDPClient::mEndpoint, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("Port", &nap::VBANUDPClient::mPort, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("MulticastTTL", &nap::VBANUDPClient::mMulticastTTL, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("MulticastLoopback", &nap::VBANUDPClient::mMulticastLoopback, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("MulticastInterface", &nap::VBANUDPClient::mMulticastInterface, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("PacketPoolSize", &nap::VBANUDPClient::mPacketPoolSize, nap::rtti::EPropertyMetaData::Default)
+RTTI_END_CLASS
+
+using namespace asio::ip;
+
+namespace nap
+{
+
+	class VBANUDPClient::Impl
+	{
+	public:
+		explicit Impl() {}
+
+		// ASIO
+		asio::io_context 			mIOContext;
+		asio::ip::udp::endpoint 	mRemoteEndpoint;
+		asio::ip::udp::socket       mSocket{ mIOContext };
+	};
+
+
+	VBANUDPClient::VBANUDPClient()
+	{
+	}
+
+
+	VBANUDPClient::~VBANUDPClient() = default;
+
+
+	bool VBANUDPClient::start(utility::ErrorState& errorState)
+	{
+		if (!errorState.check(mPacketPoolSize > 0, "%s: PacketPoolSize must be greater than zero", mID.c_str()))
+			return false;
+
+		mEvents.setSource(mID);
+		mImpl = std::make_unique<Impl>();
+		if (mPacketPool == nullptr)
+		{
+			mPacketPool = std::make_unique<VBANPacketPool>(mPacketPoolSize);
+			mQueue = std::make_unique<VBANBoundedQueue<VBANPacket*>>(mPacketPoolSize);
+		}
+
+		asio::error_code error_code;
+		auto address = asio::ip::make_address(mEndpoint, error_code);
+		if (!errorState.check(!error_code, "%s: Invalid endpoint %s: %s", mID.c_str(), mEndpoint.c_str(), error_code.message().c_str()))
+			return false;
+		if (!errorState.check(address.is_v4(), "%s: Only IPv4 endpoints are supported", mID.c_str()))
+			return false;
+		mImpl->mRemoteEndpoint = udp::endpoint(address, mPort);
+
+		mImpl->mSocket.open(udp::v4(), error_code);
+		if (!errorState.check(!error_code, "%s: Failed to open socket: %s", mID.c_str(), error_code.message().c_str()))
+			return false;
+
+		// Configure the multicast options, one send reaches all receivers that joined the group
+		if (address.is_multicast())
+		{
+			mImpl->mSocket.set_option(asio::ip::multicast::hops(mMulticastTTL), error_code);
+			if (!errorState.check(!error_code, "%s: Failed to set multicast TTL: %s", mID.c_str(), error_code.message().c_str()))
+				return false;
+
+			mImpl->mSocket.set_option(asio::ip::multicast::enable_loopback(mMulticastLoopback), error_code);
+			if (!errorState.check(!error_code, "%s: Failed to set multicast loopback: %s", mID.c_str(), error_code.message().c_str()))
+				return false;
+
+			if (!mMulticastInterface.empty())
+			{
+				auto interface_address = asio::ip::make_address_v4(mMulticastInterface, error_code);
+				if (!errorState.check(!error_code, "%s: Invalid multicast interface %s", mID.c_str(), mMulticastInterface.c_str()))
+					return false;
+
+				mImpl->mSocket.set_option(asio::ip::multicast::outbound_interface(interface_address), error_code);
+				if (!errorState.check(!error_code, "%s: Failed to set multicast interface: %s", mID.c_str(), error_code.message().c_str()))
+					return false;
+			}
+		}
+
+		mRunning.store(true);
+		mThread = std::make_unique<std::thread>([this](){ sendLoop(); });
+
+		return true;
+	}
+
+
+	void VBANUDPClient::stop()
+	{
+		// Senders that saw the client running finish queueing their packet first, later senders drop theirs
+		mRunning.store(false);
+		while (mActiveSenderCount.load() > 0)
+			std::this_thread::yield();
+
+		mSendCondition.notify_one();
+		mThread->join();
+		mThread = nullptr;
+
+		// Return the packets that were not sent to the pool
+		VBANPacket* packet = nullptr;
+		while (mQueue->tryPop(packet))
+			packet->release();
+
+		asio::error_code error_code;
+		mImpl->mSocket.close(error_code);
+		mImpl = nullptr;
+	}
+
+
+	bool VBANUDPClient::send(const void* data, size_t size)
+	{
+		assert(size <= VBAN_PROTOCOL_MAX_SIZE);
+
+		// Announce the send before checking if the client runs, so stop() can't drain the queue in between
+		mActiveSenderCount.fetch_add(1);
+		if (!mRunning.load())
+		{
+			mActiveSenderCount.fetch_sub(1);
+			return false;
+		}
+
+		// The queue holds every packet of the pool, a packet that could be acquired can always be queued
+		auto* packet = mPacketPool->acquire();
+		if (packet != nullptr)
+		{
+			std::memcpy(packet->data(), data, size);
+			packet->setSize(size);
+			mQueue->tryPush(packet);
+		}
+		mActiveSenderCount.fetch_sub(1);
+
+		if (packet == nullptr)
+		{
+			mDroppedPacketCount++;
+			return false;
+		}
+
+		// Doesn't take the mutex, a wakeup that is missed is caught by the timeout of the wait
+		mSendCondition.notify_one();
+		return true;
+	}
+
+
+	void VBANUDPClient::sendLoop()
+	{
+		asio::error_code error_code;
+		int last_error = 0;
+		VBANPacket* packet = nullptr;
+		while (mRunning.load())
+		{
+			if (!mQueue->tryPop(packet))
+			{
+				std::unique_lock<std::mutex> lock(mSendMutex);
+				mSendCondition.wait_for(lock, std::chrono::milliseconds(1), [this]() { return mQueue->getSizeApprox() > 0 || !mRunning.load(); });
+				continue;
+			}
+
+			mImpl->mSocket.send_to(asio::buffer(packet->data(), packet->size()), mImpl->mRemoteEndpoint, 0, error_code);
+			packet->release();
+
+			// Every packet fails the same way while the network is down, only a change of error is posted
+			if (error_code && error_code.value() != last_error)
+				mEvents.post(EVBANEvent::SendFailed, error_code.value());
+			last_error = error_code ? error_code.value() : 0;
+		}
+	}
+
+}
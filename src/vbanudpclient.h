@@ -0,0 +1,82 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+// Std includes
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Nap includes
+#include <nap/device.h>
+#include <nap/numeric.h>
+
+// Local includes
+#include "vbaneventqueue.h"
+#include "vbanpacket.h"
+
+namespace nap
+{
+
+	/**
+	 * VBAN specific variation on the UDPClient that sends to a unicast address or a multicast group.
+	 * When the endpoint is a multicast group a single send reaches every receiver that joined the group.
+	 * Packets are queued from the audio thread without allocating and sent on a dedicated thread.
+	 */
+	class NAPAPI VBANUDPClient : public Device
+	{
+		RTTI_ENABLE(Device)
+
+	public:
+		VBANUDPClient();
+		virtual ~VBANUDPClient();
+
+		std::string mEndpoint				= "127.0.0.1";	///< Property: 'Endpoint' the ip address to send to, either a unicast address or a multicast group
+		int mPort							= 13251;		///< Property: 'Port' the port to send to
+		int mMulticastTTL					= 1;			///< Property: 'MulticastTTL' number of router hops multicast packets are allowed to travel
+		bool mMulticastLoopback				= true;			///< Property: 'MulticastLoopback' deliver multicast packets to receivers on this host as well
+		std::string mMulticastInterface		= "";			///< Property: 'MulticastInterface' local ip address of the interface multicast is sent on, if left empty the system default is used
+		int mPacketPoolSize					= 256;			///< Property: 'PacketPoolSize' maximum number of packets waiting to be sent
+
+		// Inherited from Device
+		bool start(utility::ErrorState& errorState) override;
+		void stop() override;
+
+		/**
+		 * Queues a packet to be sent. Never blocks or allocates, can be called from the audio thread and from multiple threads at once.
+		 * Safe to call while the client is stopped, the packet is then dropped.
+		 * @param data Pointer to the packet data
+		 * @param size Size of the packet in bytes, can not exceed VBAN_PROTOCOL_MAX_SIZE
+		 * @return False when the queue was full and the packet was dropped.
+		 */
+		bool send(const void* data, size_t size);
+
+		/**
+		 * @return The number of packets that were dropped because the queue was full. Thread-Safe
+		 */
+		int64 getDroppedPacketCount() const { return mDroppedPacketCount.load(); }
+
+	private:
+		void sendLoop();
+
+		// Client specific ASIO implementation
+		class Impl;
+		std::unique_ptr<Impl> mImpl;
+
+		// The pool and queue outlive restarts, senders can still hold on to the client while it is stopped
+		std::unique_ptr<VBANPacketPool> mPacketPool;
+		std::unique_ptr<VBANBoundedQueue<VBANPacket*>> mQueue;	// Packets waiting to be sent
+
+		std::unique_ptr<std::thread> mThread = nullptr;
+		std::mutex mSendMutex;							// Only guards waiting for packets, senders never take it
+		std::condition_variable mSendCondition;
+		std::atomic<bool> mRunning = { false };
+		std::atomic<int> mActiveSenderCount = { 0 };	// Number of send() calls in progress, stop() waits for them before draining the queue
+		std::atomic<int64> mDroppedPacketCount = { 0 };
+		VBANEventQueue mEvents = { "VBANUDPClient" };	// Errors of the sending thread, logged on the main thread
+	};
+
+}
@@ -7,22 +7,66 @@
 
 // Nap includes
 #include <nap/logger.h>
+#include <utility/stringutils.h>
 
 // ASIO Includes
 #include <asio/ip/udp.hpp>
+#include <asio/ip/multicast.hpp>
 #include <asio/ts/buffer.hpp>
 #include <asio/ts/internet.hpp>
 #include <asio/io_service.hpp>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <thread>
 #include <vban/vban.h>
 
 #include "utility/threading.h"
+#include "vbaniouring.h"
+
+#ifdef __linux__
+	#include <sys/socket.h>
+	#include <sys/time.h>
+	#include <linux/filter.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <pthread.h>
+	#include <sched.h>
+	#include <cerrno>
+	#include <cstring>
+#endif
+
+RTTI_BEGIN_ENUM(nap::EVBANSchedulingPolicy)
+	RTTI_ENUM_VALUE(nap::EVBANSchedulingPolicy::Normal,		"Normal"),
+	RTTI_ENUM_VALUE(nap::EVBANSchedulingPolicy::FIFO,		"FIFO"),
+	RTTI_ENUM_VALUE(nap::EVBANSchedulingPolicy::RoundRobin,	"RoundRobin")
+RTTI_END_ENUM
+
+RTTI_BEGIN_ENUM(nap::EVBANReceiveEngine)
+	RTTI_ENUM_VALUE(nap::EVBANReceiveEngine::Socket,		"Socket"),
+	RTTI_ENUM_VALUE(nap::EVBANReceiveEngine::IOUring,		"IOUring")
+RTTI_END_ENUM
 
 RTTI_BEGIN_CLASS(nap::VBANUDPServer)
 	RTTI_PROPERTY("Port", &nap::VBANUDPServer::mPort, nap::rtti::EPropertyMetaData::Default)
 	RTTI_PROPERTY("IP Address", &nap::VBANUDPServer::mIPAddress, nap::rtti::EPropertyMetaData::Default)
 	RTTI_PROPERTY("ReceiveBufferSize", &nap::VBANUDPServer::mReceiveBufferSize, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("BatchReceive", &nap::VBANUDPServer::mBatchReceive, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("BatchSize", &nap::VBANUDPServer::mBatchSize, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("PacketPoolSize", &nap::VBANUDPServer::mPacketPoolSize, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("ShardCount", &nap::VBANUDPServer::mShardCount, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("MulticastGroup", &nap::VBANUDPServer::mMulticastGroup, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("MulticastInterface", &nap::VBANUDPServer::mMulticastInterface, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("CPUCores", &nap::VBANUDPServer::mCPUCores, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("SchedulingPolicy", &nap::VBANUDPServer::mSchedulingPolicy, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("SchedulingPriority", &nap::VBANUDPServer::mSchedulingPriority, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("ReceiveEngine", &nap::VBANUDPServer::mReceiveEngine, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("IOUringBufferCount", &nap::VBANUDPServer::mIOUringBufferCount, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("BusyPoll", &nap::VBANUDPServer::mBusyPoll, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("BusyPollTime", &nap::VBANUDPServer::mBusyPollTime, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("BusyPollSpinCount", &nap::VBANUDPServer::mBusyPollSpinCount, nap::rtti::EPropertyMetaData::Default)
+	RTTI_PROPERTY("BusyPollBackoff", &nap::VBANUDPServer::mBusyPollBackoff, nap::rtti::EPropertyMetaData::Default)
 RTTI_END_CLASS
 
 using namespace asio::ip;
@@ -37,14 +81,58 @@ namespace nap
 
 		// ASIO
 		asio::io_context 			mIOContext;
+	};
+
+
+	class VBANUDPServer::Shard
+	{
+	public:
+		Shard(asio::io_context& context, VBANPacketPool& pool, int index) : mSocket(context), mPacketPool(pool), mIndex(index) { }
+
+		asio::ip::udp::socket       mSocket;
 		asio::ip::udp::endpoint 	mRemoteEndpoint;
-		asio::ip::udp::socket       mSocket{ mIOContext };
+		VBANPacketPool&				mPacketPool;
+		int							mIndex = 0;
+		std::unique_ptr<std::thread> mThread = nullptr;
+
+		Packet* mPacket = nullptr;						// Packet currently held for receiving, kept as long as no listener retains it
+		std::vector<Packet*> mBatch;					// Packets currently held for batch receive
+		Packet mOverflowPacket;							// Receives datagrams that are dropped when the pool is exhausted
+
+#ifdef __linux__
+		// Message headers and io vectors for batch receive, preallocated on start
+		std::vector<mmsghdr>		mMessages;
+		std::vector<iovec>			mIOVectors;
+		std::vector<sockaddr_in>	mSourceAddresses;
+		std::vector<std::array<char, CMSG_SPACE(sizeof(timespec))>> mControlBuffers;
+
+		// Set when receiving through io_uring
+		std::unique_ptr<VBANIOUring> mIOUring = nullptr;
+#endif
 	};
 
 
+#ifdef __linux__
+	// Returns the kernel receive timestamp of a message, or the current time when the kernel didn't provide one.
+	// Both are in nanoseconds since the epoch.
+	static int64 getReceiveTimestamp(msghdr& message)
+	{
+		for (auto* control = CMSG_FIRSTHDR(&message); control != nullptr; control = CMSG_NXTHDR(&message, control))
+		{
+			if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SCM_TIMESTAMPNS)
+			{
+				timespec time;
+				std::memcpy(&time, CMSG_DATA(control), sizeof(time));
+				return static_cast<int64>(time.tv_sec) * 1000000000 + time.tv_nsec;
+			}
+		}
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+#endif
+
+
 	VBANUDPServer::VBANUDPServer()
 	{
-		mPacket.reserve(VBAN_PROTOCOL_MAX_SIZE);
 	}
 
 
@@ -53,14 +141,185 @@ namespace nap
 
 	bool nap::VBANUDPServer::start(nap::utility::ErrorState &errorState)
 	{
-		// when asio error occurs, init_success indicates whether initialization should fail or succeed
-		bool init_success = false;
+		if (!errorState.check(mPacketPoolSize > 0, "%s: PacketPoolSize must be greater than zero", mID.c_str()))
+			return false;
+		mEvents.setSource(mID);
+		if (!errorState.check(mShardCount > 0, "%s: ShardCount must be greater than zero", mID.c_str()))
+			return false;
+		if (!errorState.check((!mBatchReceive && mReceiveEngine != EVBANReceiveEngine::IOUring) || mBatchSize > 0, "%s: BatchSize must be greater than zero", mID.c_str()))
+			return false;
+		if (!errorState.check(mSchedulingPriority >= 0, "%s: SchedulingPriority can't be negative", mID.c_str()))
+			return false;
+		if (!errorState.check(mBusyPollTime >= 0 && mBusyPollSpinCount >= 0 && mBusyPollBackoff >= 0, "%s: Busy poll settings can't be negative", mID.c_str()))
+			return false;
+
+		// Every socket in a reuseport group receives its own copy of multicast datagrams
+		if (!errorState.check(mMulticastGroup.empty() || mShardCount == 1, "%s: Multicast receive requires a ShardCount of 1", mID.c_str()))
+			return false;
+
+		// Sharding relies on the kernel distributing datagrams over sockets bound to the same port
+		int shard_count = mShardCount;
+#ifndef __linux__
+		if (shard_count > 1)
+		{
+			nap::Logger::warn(*this, "Sharded receive is only supported on Linux, receiving on a single thread");
+			shard_count = 1;
+		}
+#endif
 
 		mImpl = std::make_unique<Impl>();
 
+		// The pools outlive restarts of the server, listeners might still retain packets from a previous session
+		while (mPacketPools.size() < shard_count)
+			mPacketPools.emplace_back(std::make_unique<VBANPacketPool>(mPacketPoolSize));
+		mRetiredBuffers.erase(std::remove_if(mRetiredBuffers.begin(), mRetiredBuffers.end(), [](const auto& buffers)
+		{
+			return buffers->getHeldBufferCount() == 0;
+		}), mRetiredBuffers.end());
+
+		nap::Logger::info(*this, "Listening at port %i", mPort);
+		for (auto i = 0; i < shard_count; ++i)
+		{
+			mShards.emplace_back(std::make_unique<Shard>(mImpl->mIOContext, *mPacketPools[i], i));
+			if (!openSocket(*mShards.back(), errorState))
+			{
+				mShards.clear();
+				mImpl = nullptr;
+				return false;
+			}
+		}
+
+		if (mShards.size() > 1)
+			attachStreamSteering();
+
+		mRunning.store(true);
+		for (auto& shard : mShards)
+		{
+			// The thread pins itself and acquires its priority before it receives, so no packet is handled with default scheduling
+			auto index = shard->mIndex;
+			auto core = index < mCPUCores.size() ? mCPUCores[index] : -1;
+			shard->mThread = std::make_unique<std::thread>([this, index, core](){
+				configureCurrentThread(core, utility::stringFormat("receive thread %i", index));
+				threadFunction(index);
+			});
+		}
+
+		return true;
+	}
+
+
+	void nap::VBANUDPServer::stop()
+	{
+		mRunning.store(false);
+
+#ifndef __linux__
+		// The asio receive blocks without a timeout, closing the socket is what interrupts it
+		closeSockets();
+#endif
+
+		// On Linux the receiving threads use the native socket handle, which the system can hand out again once the socket is closed.
+		// They notice the server stopped within the receive timeout, so the sockets are only closed once the threads are done with them.
+		for (auto& shard : mShards)
+		{
+			shard->mThread->join();
+
+			// Return the packets held for receiving to the pool
+			if (shard->mPacket != nullptr)
+				shard->mPacket->release();
+			for (auto& packet : shard->mBatch)
+			{
+				if (packet != nullptr)
+					packet->release();
+			}
+
+#ifdef __linux__
+			// Packets received through io_uring refer to its buffers
+			if (shard->mIOUring != nullptr)
+				mRetiredBuffers.emplace_back(std::move(shard->mIOUring));
+#endif
+		}
+
+#ifdef __linux__
+		closeSockets();
+#endif
+
+		// explicitly delete sockets
+		mShards.clear();
+		mImpl = nullptr;
+	}
+
+
+	void nap::VBANUDPServer::closeSockets()
+	{
+		for (auto& shard : mShards)
+		{
+			asio::error_code asio_error_code;
+			shard->mSocket.close(asio_error_code);
+			if (asio_error_code)
+				nap::Logger::error(*this, asio_error_code.message());
+		}
+	}
+
+
+	void VBANUDPServer::threadFunction(int shard)
+	{
+		workLoop(shard);
+	}
+
+
+	void nap::VBANUDPServer::configureCurrentThread(int core, const std::string& name)
+	{
+		// Pin the thread to its core
+		if (core >= 0)
+		{
+#ifdef __linux__
+			cpu_set_t cpu_set;
+			CPU_ZERO(&cpu_set);
+			CPU_SET(core, &cpu_set);
+			if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0)
+				nap::Logger::warn(*this, "Failed to pin %s to core %i", name.c_str(), core);
+#elif defined(_WIN32)
+			if (SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core) == 0)
+				nap::Logger::warn(*this, "Failed to pin %s to core %i", name.c_str(), core);
+#else
+			nap::Logger::warn(*this, "Pinning threads to cores is not supported on this platform");
+#endif
+		}
+
+		if (mSchedulingPolicy == EVBANSchedulingPolicy::Normal)
+			return;
+
+		// Realtime priority prevents the thread from being preempted by the OS scheduler.
+		// Without the privileges to acquire it the thread keeps running with normal scheduling.
+#ifdef _WIN32
+		if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) == 0)
+			nap::Logger::warn(*this, "Failed to acquire realtime priority for %s, using normal scheduling", name.c_str());
+#else
+		const int policy = mSchedulingPolicy == EVBANSchedulingPolicy::FIFO ? SCHED_FIFO : SCHED_RR;
+		const int min_priority = sched_get_priority_min(policy);
+		const int max_priority = sched_get_priority_max(policy);
+		sched_param sched_params;
+		sched_params.sched_priority = mSchedulingPriority == 0 ? max_priority : std::clamp(mSchedulingPriority, min_priority, max_priority);
+		if (sched_params.sched_priority != mSchedulingPriority && mSchedulingPriority != 0)
+			nap::Logger::warn(*this, "SchedulingPriority %i is out of range, using %i", mSchedulingPriority, sched_params.sched_priority);
+
+		auto result = pthread_setschedparam(pthread_self(), policy, &sched_params);
+		if (result == EPERM)
+			nap::Logger::warn(*this, "No privilege to set realtime scheduling for %s, using normal scheduling", name.c_str());
+		else if (result != 0)
+			nap::Logger::warn(*this, "Failed to set realtime scheduling for %s: %s, using normal scheduling", name.c_str(), strerror(result));
+#endif
+	}
+
+
+	bool nap::VBANUDPServer::openSocket(Shard& shard, utility::ErrorState& errorState)
+	{
+		// when asio error occurs, init_success indicates whether initialization should fail or succeed
+		bool init_success = false;
+
 		// try to open socket
 		asio::error_code errorCode;
-		mImpl->mSocket.open(udp::v4(), errorCode);
+		shard.mSocket.open(udp::v4(), errorCode);
 		if (handleAsioError(errorCode, errorState, init_success))
 			return init_success;
 
@@ -77,103 +336,401 @@ namespace nap
 				return init_success;
 		}
 
-		nap::Logger::info(*this, "Listening at port %i", mPort);
-		mImpl->mSocket.bind(udp::endpoint(address,mPort), errorCode);
-		mImpl->mSocket.set_option(asio::ip::udp::socket::receive_buffer_size(mReceiveBufferSize));
+#ifdef __linux__
+		// Let all shards bind to the same port
+		if (mShardCount > 1)
+		{
+			int reuse_port = 1;
+			if (setsockopt(shard.mSocket.native_handle(), SOL_SOCKET, SO_REUSEPORT, &reuse_port, sizeof(reuse_port)) != 0)
+			{
+				errorState.fail("%s: Failed to enable SO_REUSEPORT: %s", mID.c_str(), strerror(errno));
+				return false;
+			}
+		}
+#endif
+
+		// Allow multiple receivers on this host to bind to the port of the group
+		if (!mMulticastGroup.empty())
+		{
+			shard.mSocket.set_option(asio::socket_base::reuse_address(true), errorCode);
+			if (handleAsioError(errorCode, errorState, init_success))
+				return init_success;
+		}
+
+		shard.mSocket.bind(udp::endpoint(address,mPort), errorCode);
+		shard.mSocket.set_option(asio::ip::udp::socket::receive_buffer_size(mReceiveBufferSize));
 		if (handleAsioError(errorCode, errorState, init_success))
 			return init_success;
 
-		mRunning.store(true);
-		mThread = std::make_unique<std::thread>([&](){
-			threadFunction();
-		});
+		// Join the multicast group on the requested interface
+		if (!mMulticastGroup.empty())
+		{
+			auto group = asio::ip::make_address_v4(mMulticastGroup, errorCode);
+			if (handleAsioError(errorCode, errorState, init_success))
+				return init_success;
+			if (!errorState.check(group.is_multicast(), "%s: %s is not a multicast address", mID.c_str(), mMulticastGroup.c_str()))
+				return false;
 
-		// Set thread priority to realtime priority to prevent the thread from being preempted by the OS scheduler.
-#ifdef _WIN32
-		auto result = SetThreadPriority(mThread->native_handle(), THREAD_PRIORITY_TIME_CRITICAL);
-		// If this assertion fails the thread failed to acquire realtime priority
-		assert(result != 0);
+			auto interface_address = asio::ip::address_v4::any();
+			if (!mMulticastInterface.empty())
+			{
+				interface_address = asio::ip::make_address_v4(mMulticastInterface, errorCode);
+				if (handleAsioError(errorCode, errorState, init_success))
+					return init_success;
+			}
+
+#ifdef __linux__
+			// Only receive the groups joined by this socket, not those joined by other sockets on the same port
+			int multicast_all = 0;
+			setsockopt(shard.mSocket.native_handle(), IPPROTO_IP, IP_MULTICAST_ALL, &multicast_all, sizeof(multicast_all));
+#endif
+
+			shard.mSocket.set_option(asio::ip::multicast::join_group(group, interface_address), errorCode);
+			if (handleAsioError(errorCode, errorState, init_success))
+				return init_success;
+
+			nap::Logger::info(*this, "Joined multicast group %s", mMulticastGroup.c_str());
+		}
+
+#ifdef __linux__
+		// On Linux datagrams are always received with recvmmsg, a batch of one when batch receive is disabled.
+		// This gives access to the kernel receive timestamps that are delivered as ancillary data.
+		const int batch_size = mBatchReceive ? mBatchSize : 1;
+		shard.mBatch.assign(batch_size, nullptr);
+		shard.mMessages.resize(batch_size);
+		shard.mIOVectors.resize(batch_size);
+		shard.mSourceAddresses.resize(batch_size);
+		shard.mControlBuffers.resize(batch_size);
+		for (auto i = 0; i < batch_size; ++i)
+		{
+			shard.mIOVectors[i].iov_base = nullptr;
+			shard.mIOVectors[i].iov_len = VBAN_PROTOCOL_MAX_SIZE;
+			shard.mMessages[i] = {};
+			shard.mMessages[i].msg_hdr.msg_iov = &shard.mIOVectors[i];
+			shard.mMessages[i].msg_hdr.msg_iovlen = 1;
+			shard.mMessages[i].msg_hdr.msg_name = &shard.mSourceAddresses[i];
+			shard.mMessages[i].msg_hdr.msg_control = shard.mControlBuffers[i].data();
+		}
+
+		// Let the kernel timestamp every datagram on arrival
+		int timestamps = 1;
+		if (setsockopt(shard.mSocket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &timestamps, sizeof(timestamps)) != 0)
+			nap::Logger::warn(*this, "Failed to enable kernel receive timestamps: %s", strerror(errno));
+
+		// Set up io_uring, the socket receive remains available as fallback
+		if (mReceiveEngine == EVBANReceiveEngine::IOUring)
+		{
+			utility::ErrorState io_uring_error;
+			shard.mIOUring = std::make_unique<VBANIOUring>();
+			if (!shard.mIOUring->init(shard.mSocket.native_handle(), mIOUringBufferCount, io_uring_error))
+			{
+				nap::Logger::warn(*this, "%s, falling back to socket receive", io_uring_error.toString().c_str());
+				shard.mIOUring = nullptr;
+			}
+			else
+			{
+				// Collecting datagrams from the ring doesn't take a system call per datagram, always dispatch them in batches
+				shard.mBatch.assign(mBatchSize, nullptr);
+				if (mBusyPoll && shard.mIndex == 0)
+					nap::Logger::warn(*this, "Busy poll is not used when receiving through io_uring");
+			}
+		}
+
+		if (mBusyPoll && shard.mIOUring == nullptr)
+		{
+			// Let the kernel poll the device queue for the duration of every receive call instead of waiting for an interrupt.
+			// Raising the time above the net.core.busy_read sysctl requires CAP_NET_ADMIN.
+			if (mBusyPollTime > 0 && setsockopt(shard.mSocket.native_handle(), SOL_SOCKET, SO_BUSY_POLL, &mBusyPollTime, sizeof(mBusyPollTime)) != 0)
+				nap::Logger::warn(*this, "Failed to enable kernel busy polling: %s", strerror(errno));
+
+			shard.mSocket.non_blocking(true, errorCode);
+			if (handleAsioError(errorCode, errorState, init_success))
+				return init_success;
+		}
+		else {
+			// Wake up periodically so the thread can be stopped while no packets are coming in
+			timeval timeout = { 0, 100000 };
+			setsockopt(shard.mSocket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		}
 #else
-		sched_param schedParams;
-		schedParams.sched_priority = sched_get_priority_max(SCHED_FIFO);
-		auto result = pthread_setschedparam(mThread->native_handle(), SCHED_FIFO, &schedParams);
-		// If this assertion fails the thread failed to acquire realtime priority
-		if (result == ESRCH)
-			Logger::error("No thread with specified id");
-		else if (result == EINVAL)
-			Logger::error("Thread policy FIFO not recognized");
-		else if (result == EPERM)
-			Logger::error("No privilige to set thread policy");
-		else if (result == ENOTSUP)
-			Logger::error("Priority not supported");
-		assert(result == 0);
+		if (mBatchReceive && shard.mIndex == 0)
+			nap::Logger::warn(*this, "Batch receive is only supported on Linux, falling back to single packet receive");
+		if (mBusyPoll && shard.mIndex == 0)
+			nap::Logger::warn(*this, "Busy poll is only supported on Linux, falling back to blocking receive");
+		if (mReceiveEngine == EVBANReceiveEngine::IOUring && shard.mIndex == 0)
+			nap::Logger::warn(*this, "io_uring is only supported on Linux, falling back to socket receive");
 #endif
 
 		return true;
 	}
 
 
-	void nap::VBANUDPServer::stop()
+	void nap::VBANUDPServer::attachStreamSteering()
 	{
-		mRunning.store(false);
+#ifdef __linux__
+		// Classic BPF program that runs on the UDP payload of every datagram and returns the index of the socket in the reuseport group.
+		// It hashes the 16 byte stream name at offset 8 of the VBAN header, so all packets of a stream are received by the same shard in order.
+		const auto shard_count = static_cast<uint32_t>(mShards.size());
+		sock_filter code[] =
+		{
+			{ BPF_LD  | BPF_W | BPF_ABS,	0, 0, 8 },				// A = name[0..3]
+			{ BPF_MISC | BPF_TAX,			0, 0, 0 },				// X = A
+			{ BPF_LD  | BPF_W | BPF_ABS,	0, 0, 12 },				// A = name[4..7]
+			{ BPF_ALU | BPF_XOR | BPF_X,	0, 0, 0 },				// A ^= X
+			{ BPF_MISC | BPF_TAX,			0, 0, 0 },
+			{ BPF_LD  | BPF_W | BPF_ABS,	0, 0, 16 },				// A = name[8..11]
+			{ BPF_ALU | BPF_XOR | BPF_X,	0, 0, 0 },
+			{ BPF_MISC | BPF_TAX,			0, 0, 0 },
+			{ BPF_LD  | BPF_W | BPF_ABS,	0, 0, 20 },				// A = name[12..15]
+			{ BPF_ALU | BPF_XOR | BPF_X,	0, 0, 0 },
+			{ BPF_MISC | BPF_TAX,			0, 0, 0 },				// Fold all bytes into the lowest byte
+			{ BPF_ALU | BPF_RSH | BPF_K,	0, 0, 16 },
+			{ BPF_ALU | BPF_XOR | BPF_X,	0, 0, 0 },
+			{ BPF_MISC | BPF_TAX,			0, 0, 0 },
+			{ BPF_ALU | BPF_RSH | BPF_K,	0, 0, 8 },
+			{ BPF_ALU | BPF_XOR | BPF_X,	0, 0, 0 },
+			{ BPF_ALU | BPF_MOD | BPF_K,	0, 0, shard_count },	// A %= shard count
+			{ BPF_RET | BPF_A,				0, 0, 0 },
+		};
+		sock_fprog program = { static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code };
+
+		// The program applies to the whole reuseport group
+		if (setsockopt(mShards.front()->mSocket.native_handle(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) != 0)
+			nap::Logger::warn(*this, "Failed to steer streams to shards, falling back to steering by sender address: %s", strerror(errno));
+#endif
+	}
+
+
+	void nap::VBANUDPServer::workLoop(int index)
+	{
+		auto& shard = *mShards[index];
+
+#ifdef __linux__
+		if (shard.mIOUring != nullptr)
+			ioUringWorkLoop(shard);
+		else
+			batchWorkLoop(shard);
+		return;
+#endif
 
 		asio::error_code asio_error_code;
-		mImpl->mSocket.close(asio_error_code);
-		if (asio_error_code)
-			nap::Logger::error(*this, asio_error_code.message());
 
-		mThread->join();
+		while (mRunning.load())
+		{
+			if (shard.mPacket == nullptr)
+			{
+				shard.mPacket = shard.mPacketPool.acquire();
+				if (shard.mPacket == nullptr)
+				{
+					dropPacket(shard);
+					continue;
+				}
+			}
 
-		// explicitly delete socket
-		mImpl = nullptr;
+			uint len = shard.mSocket.receive_from(asio::buffer(shard.mPacket->data(), shard.mPacket->capacity()), shard.mRemoteEndpoint, 0, asio_error_code);
+			if (asio_error_code)
+			{
+				// The socket is closed to stop the thread, the receive then fails as expected
+				if (mRunning.load())
+					mEvents.post(EVBANEvent::ReceiveFailed, asio_error_code.value());
+				continue;
+			}
+
+			if (len > 0)
+			{
+				assert(len <= VBAN_PROTOCOL_MAX_SIZE);
+				shard.mPacket->setSize(len);
+				shard.mPacket->setSource({ shard.mRemoteEndpoint.address().to_v4().to_uint(), shard.mRemoteEndpoint.port() });
+				shard.mPacket->setTimestamp(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+				packetsReceived(&shard.mPacket, 1);
+
+				// Keep receiving into the same packet unless a listener holds on to it
+				if (!shard.mPacket->isUnique())
+				{
+					shard.mPacket->release();
+					shard.mPacket = nullptr;
+				}
+			}
+		}
 	}
 
-	void VBANUDPServer::threadFunction()
+
+	void nap::VBANUDPServer::batchWorkLoop(Shard& shard)
 	{
-		workLoop();
+#ifdef __linux__
+		auto& messages = shard.mMessages;
+		auto& batch = shard.mBatch;
+		const auto socket = shard.mSocket.native_handle();
+
+		// When busy polling, return immediately with whatever is queued up, otherwise block until at least one datagram arrived
+		const int flags = mBusyPoll ? MSG_DONTWAIT : MSG_WAITFORONE;
+		int idle_polls = 0;
+
+		while (mRunning.load())
+		{
+			// Fill up the batch with packets from the pool, packets that were not retained by listeners are still held from the previous batch
+			int available = 0;
+			for (; available < batch.size(); ++available)
+			{
+				auto& packet = batch[available];
+				if (packet == nullptr)
+				{
+					packet = shard.mPacketPool.acquire();
+					if (packet == nullptr)
+						break;
+				}
+				shard.mIOVectors[available].iov_base = packet->data();
+				messages[available].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+				messages[available].msg_hdr.msg_controllen = shard.mControlBuffers[available].size();
+			}
+
+			if (available == 0)
+			{
+				dropPacket(shard);
+				continue;
+			}
+
+			int count = recvmmsg(socket, messages.data(), available, flags, nullptr);
+			if (count < 0)
+			{
+				// Timeouts and interrupts are expected, the thread checks whether the server is stopping after every timeout
+				if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && mRunning.load())
+					mEvents.post(EVBANEvent::ReceiveFailed, errno);
+
+				// Keep spinning for a while, then back off to give other work on the core a chance
+				if (mBusyPoll && ++idle_polls > mBusyPollSpinCount)
+				{
+					if (mBusyPollBackoff > 0)
+						std::this_thread::sleep_for(std::chrono::microseconds(mBusyPollBackoff));
+					else
+						std::this_thread::yield();
+				}
+				continue;
+			}
+			idle_polls = 0;
+
+			for (auto i = 0; i < count; ++i)
+			{
+				batch[i]->setSize(messages[i].msg_len);
+				const auto& source = shard.mSourceAddresses[i];
+				batch[i]->setSource({ ntohl(source.sin_addr.s_addr), ntohs(source.sin_port) });
+				batch[i]->setTimestamp(getReceiveTimestamp(messages[i].msg_hdr));
+			}
+
+			// Hand the whole batch to the listeners at once
+			packetsReceived(batch.data(), count);
+
+			// Keep the packets that no listener holds on to for the next batch
+			for (auto i = 0; i < count; ++i)
+			{
+				if (!batch[i]->isUnique())
+				{
+					batch[i]->release();
+					batch[i] = nullptr;
+				}
+			}
+		}
+#else
+		assert(false);
+#endif
 	}
 
 
-	void nap::VBANUDPServer::workLoop()
+	void nap::VBANUDPServer::ioUringWorkLoop(Shard& shard)
 	{
-		asio::error_code asio_error_code;
+#ifdef __linux__
+		auto& batch = shard.mBatch;
+		const int batch_size = static_cast<int>(batch.size());
 
 		while (mRunning.load())
 		{
-			try
+			// Wake up periodically so the thread can be stopped while no packets are coming in
+			const auto& datagrams = shard.mIOUring->receive(batch_size, 100);
+
+			// Wrap the kernel buffers in pooled packets without copying, a buffer returns to the kernel when its packet is released
+			int count = 0;
+			for (const auto& datagram : datagrams)
 			{
-				mPacket.resize(VBAN_PROTOCOL_MAX_SIZE);
-				uint len = mImpl->mSocket.receive(asio::buffer(mPacket));
-				if (len > 0)
+				auto* packet = shard.mPacketPool.acquire();
+				if (packet == nullptr)
 				{
-					assert(len <= VBAN_PROTOCOL_MAX_SIZE);
-					mPacket.resize(len);
-					std::lock_guard<std::mutex> lock(mMutex);
-					packetReceived.trigger(mPacket);
+					shard.mIOUring->releaseBuffer(datagram.mBufferID);
+					mDroppedPacketCount++;
+					continue;
 				}
+
+				packet->setExternalData(datagram.mData, datagram.mSize, *shard.mIOUring, datagram.mBufferID);
+				packet->setSource(datagram.mSource);
+				packet->setTimestamp(datagram.mTimestamp != 0 ? datagram.mTimestamp :
+					std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+				batch[count++] = packet;
 			}
-			catch (std::exception &e)
+
+			if (count == 0)
+				continue;
+
+			packetsReceived(batch.data(), count);
+
+			// Packets refer to the kernel buffers, so they can't be kept for the next batch like in the socket loops
+			for (auto i = 0; i < count; ++i)
 			{
-				// Catch this exception for when the thread is killed at shutdown
+				batch[i]->release();
+				batch[i] = nullptr;
 			}
+		}
+#else
+		assert(false);
+#endif
+	}
 
-			if (asio_error_code)
-				nap::Logger::error(*this, asio_error_code.message());
+
+	void nap::VBANUDPServer::dropPacket(Shard& shard)
+	{
+		// Only receive when a datagram is queued, so the thread is back to acquiring packets as soon as listeners release them
+		asio::error_code asio_error_code;
+		if (shard.mSocket.available(asio_error_code) > 0 && !asio_error_code)
+		{
+			shard.mSocket.receive(asio::buffer(shard.mOverflowPacket.data(), shard.mOverflowPacket.capacity()), 0, asio_error_code);
+			if (!asio_error_code)
+				mDroppedPacketCount++;
+			return;
+		}
+
+		// Nothing to drop, give the listeners a moment to release packets
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+
+
+	void nap::VBANUDPServer::packetsReceived(Packet* const* packets, int count)
+	{
+		// The listener list is read without locking, listeners are only removed once the receiving threads are done with them
+		VBANReadCopyUpdate<Listeners>::ReadSection listeners(mListeners);
+		for (auto i = 0; i < count; ++i)
+		{
+			if (packets[i]->empty())
+				continue;
+			for (auto* slot : listeners->mSlots)
+				slot->trigger(*packets[i]);
+			packetReceived.trigger(*packets[i]);
 		}
 	}
 
 
 	void nap::VBANUDPServer::registerListenerSlot(Slot<const Packet&>& slot)
 	{
-		std::lock_guard<std::mutex> lock(mMutex);
-		packetReceived.connect(slot);
+		mListeners.update([&slot](Listeners& listeners)
+		{
+			listeners.mSlots.emplace_back(&slot);
+		});
 	}
 
 
 	void nap::VBANUDPServer::removeListenerSlot(nap::Slot<const Packet&> &slot)
 	{
-		std::lock_guard<std::mutex> lock(mMutex);
-		packetReceived.disconnect(slot);
+		mListeners.update([&slot](Listeners& listeners)
+		{
+			listeners.mSlots.erase(std::remove(listeners.mSlots.begin(), listeners.mSlots.end(), &slot), listeners.mSlots.end());
+		});
 	}
 
 
@@ -190,4 +747,4 @@ namespace nap
 	}
 
 
-}
\ No newline at end of file
+}
@@ -4,7 +4,6 @@
 
 
 #pragma once
-#include <concurrentqueue.h>
 #include <nap/numeric.h>
 #include <nap/signalslot.h>
 #include <udppacket.h>
@@ -15,10 +14,34 @@
 #include <udpadapter.h>
 #include <vban/vban.h>
 
+#include "vbanpacket.h"
+#include "vbanreadcopyupdate.h"
+#include "vbaneventqueue.h"
+
 
 namespace nap
 {
 
+	/**
+	 * Scheduling policy of the receiving threads.
+	 */
+	enum class EVBANSchedulingPolicy : int
+	{
+		Normal		= 0,	///< Default time-sharing scheduling of the OS
+		FIFO		= 1,	///< Realtime, runs until it blocks or is preempted by a thread of higher priority
+		RoundRobin	= 2		///< Realtime, like FIFO but shares the CPU with threads of equal priority
+	};
+
+
+	/**
+	 * Mechanism the receiving threads use to receive datagrams.
+	 */
+	enum class EVBANReceiveEngine : int
+	{
+		Socket		= 0,	///< Blocking socket receive, recvmmsg on Linux
+		IOUring		= 1		///< io_uring multishot receive into provided buffers, Linux 6.0 and higher
+	};
+
 
 	/**
 	 * VBAN specific variation on the UDPServer.
@@ -28,27 +51,49 @@ namespace nap
 		RTTI_ENABLE(Device)
 
 	public:
-		using Packet = std::vector<uint8_t>;
+		using Packet = VBANPacket;
 
 	public:
 		VBANUDPServer();
 		virtual ~VBANUDPServer();
 
 		/**
-		 * Connects a listener slot to the packetReceived signal. Thread-Safe
+		 * Adds a listener slot that is invoked on the receiving thread for every received packet. Thread-Safe
+		 * Never blocks the receiving thread. The packet is only valid during the call, unless the listener retains it.
 		 * @param slot the slot that will be invoked when a packet is received
 		 */
 		void registerListenerSlot(Slot<const Packet&>& slot);
 
 		/**
-		 * Disconnects a listener slot from the packetReceived signal. Thread-Safe
-		 * @param slot the slot that will be disconnected
+		 * Removes a listener slot. Thread-Safe
+		 * Never blocks the receiving thread. Returns when the slot is guaranteed not to be invoked anymore.
+		 * @param slot the slot that will be removed
 		 */
 		void removeListenerSlot(Slot<const Packet&>& slot);
 
+		/**
+		 * @return The number of packets that were dropped because all packets in the pool were in use. Thread-Safe
+		 */
+		int64 getDroppedPacketCount() const { return mDroppedPacketCount.load(); }
+
 		int mPort 						= 13251;		///< Property: 'Port' the port the server socket binds to
 		std::string mIPAddress			= "";	        ///< Property: 'IP Address' local ip address to bind to, if left empty will bind to any local address
 		int mReceiveBufferSize = 1000000;				///< Property: 'ReceiveBufferSize'
+		bool mBatchReceive				= false;		///< Property: 'BatchReceive' receive multiple datagrams per system call (Linux only)
+		int mBatchSize					= 32;			///< Property: 'BatchSize' maximum number of datagrams received per system call when batch receive is enabled, or dispatched at once when receiving through io_uring
+		int mPacketPoolSize				= 256;			///< Property: 'PacketPoolSize' number of preallocated packets per shard that are received into and handed to listeners
+		int mShardCount					= 1;			///< Property: 'ShardCount' number of sockets and threads receiving on the same port, each stream is always received by the same shard (Linux only)
+		std::string mMulticastGroup		= "";			///< Property: 'MulticastGroup' multicast group address to join, if left empty only unicast packets are received
+		std::string mMulticastInterface	= "";			///< Property: 'MulticastInterface' local ip address of the interface to join the multicast group on, if left empty the system default is used
+		std::vector<int> mCPUCores		= { };			///< Property: 'CPUCores' CPU core to pin each receiving thread to, in order of the shards. Left empty the threads are not pinned
+		EVBANSchedulingPolicy mSchedulingPolicy = EVBANSchedulingPolicy::FIFO;	///< Property: 'SchedulingPolicy' scheduling policy of the receiving threads, falls back to normal scheduling when not permitted
+		int mSchedulingPriority			= 0;			///< Property: 'SchedulingPriority' realtime priority of the receiving threads, 0 uses the maximum priority of the policy
+		EVBANReceiveEngine mReceiveEngine = EVBANReceiveEngine::Socket;	///< Property: 'ReceiveEngine' how datagrams are received, falls back to Socket when io_uring is not available
+		int mIOUringBufferCount			= 256;			///< Property: 'IOUringBufferCount' number of buffers per shard the kernel receives into when using io_uring
+		bool mBusyPoll					= false;		///< Property: 'BusyPoll' poll the socket without blocking instead of waiting for packets, only use on an isolated core (Linux only)
+		int mBusyPollTime				= 50;			///< Property: 'BusyPollTime' microseconds the kernel busy polls the device queue per receive call (SO_BUSY_POLL), 0 disables kernel busy polling
+		int mBusyPollSpinCount			= 10000;		///< Property: 'BusyPollSpinCount' number of empty polls after which the thread backs off
+		int mBusyPollBackoff			= 0;			///< Property: 'BusyPollBackoff' microseconds to sleep between polls when backing off, 0 only yields the CPU
 
 		// Inherited from Device
 		bool start(utility::ErrorState& errorState) override;
@@ -57,28 +102,85 @@ namespace nap
 		/**
 		 * By default just calls the workLoop() function.
 		 * Override this function to add specific behaviour before and/or after the workloop.
+		 * @param shard Index of the shard the thread receives for
+		 */
+		virtual void threadFunction(int shard);
+
+		/**
+		 * @return The number of shards that are actually receiving, equal to ShardCount on platforms that support sharding and 1 otherwise.
 		 */
-		virtual void threadFunction();
+		int getActiveShardCount() const { return static_cast<int>(mShards.size()); }
+
+		/**
+		 * Applies the scheduling policy and priority of the receiving threads to the calling thread, and optionally pins it to a core.
+		 * Every receiving thread calls this before it receives its first packet. Threads that process the received packets can call it as well.
+		 * Without the privileges for realtime scheduling the thread keeps running with normal scheduling.
+		 * @param core CPU core to pin the thread to, a negative core leaves the affinity as is
+		 * @param name Name of the thread in warnings
+		 */
+		void configureCurrentThread(int core, const std::string& name);
 
 	protected:
 		/**
-		 * packet received signal will be dispatched on the thread this UDPServer is registered to, see UDPThread
+		 * Triggered on the receiving thread for every received packet, after the registered listener slots.
+		 * @deprecated Use registerListenerSlot() instead. Connections to the signal are not synchronized with the receiving threads, only connect while the server is stopped.
 		 */
 		Signal<const Packet&> packetReceived;
 
-		void workLoop();
+		/**
+		 * Hands received packets to all registered listeners, called from the receiving thread.
+		 * @param packets Array of received packets
+		 * @param count Number of packets in the array
+		 */
+		void packetsReceived(Packet* const* packets, int count);
+
+		/**
+		 * Receives packets for the given shard until the server is stopped.
+		 * @param shard Index of the shard
+		 */
+		void workLoop(int shard);
 
 	private:
+		// Socket, thread and packets of a single receiving thread
+		class Shard;
+
+		// Receives up to mBatchSize datagrams per system call and dispatches them at once, Linux only
+		void batchWorkLoop(Shard& shard);
+
+		// Receives datagrams through io_uring and dispatches them in batches, Linux only
+		void ioUringWorkLoop(Shard& shard);
+
+		// Drops a queued datagram when no pooled packet is available, without waiting for one to arrive
+		void dropPacket(Shard& shard);
+
+		// Opens, configures and binds the socket of a shard
+		bool openSocket(Shard& shard, utility::ErrorState& errorState);
+
+		// Makes the kernel steer all packets of a stream to the same shard
+		void attachStreamSteering();
+
+		// Closes the sockets of all shards
+		void closeSockets();
+
 		bool handleAsioError(const std::error_code& errorCode, utility::ErrorState& errorState, bool& success);
 
 		// Server specific ASIO implementation
 		class Impl;
 		std::unique_ptr<Impl> mImpl;
-
-		std::unique_ptr<std::thread> mThread = nullptr;
-		Packet mPacket; // The packet data is being reused to avoid unnecessary reallocations and copies.
+		std::vector<std::unique_ptr<Shard>> mShards;
+		std::vector<std::unique_ptr<VBANPacketPool>> mPacketPools;	// One per shard, outlive restarts because listeners might still retain packets
+		std::vector<std::unique_ptr<VBANPacketBufferOwner>> mRetiredBuffers;	// io_uring buffers of stopped shards, kept until listeners released the packets referring to them
+
+		// Immutable list of listener slots, replaced as a whole when listeners are added or removed
+		struct Listeners
+		{
+			std::vector<Slot<const Packet&>*> mSlots;
+		};
+		VBANReadCopyUpdate<Listeners> mListeners;
+
+		std::atomic<int64> mDroppedPacketCount = { 0 };
 		std::atomic<bool> mRunning;
-		std::mutex mMutex;
+		VBANEventQueue mEvents = { "VBANUDPServer" };	// Errors of the receiving threads, logged on the main thread
 	};
 
 } // nap
@@ -4,6 +4,9 @@
 
 #include "vbanutils.h"
 
+#include <algorithm>
+#include <cstdio>
+
 namespace nap
 {
 
@@ -31,4 +34,42 @@ namespace nap
 		return false;
 	}
 
-}
\ No newline at end of file
+
+	int utility::getVBANMaxSampleRate()
+	{
+		long max_sample_rate = 0;
+		for (int i = 0; i < VBAN_SR_MAXNUMBER; i++)
+			max_sample_rate = std::max(max_sample_rate, VBanSRList[i]);
+		return static_cast<int>(max_sample_rate);
+	}
+
+
+
+	bool utility::getVBANEndpointFromString(VBANEndpoint& endpoint, const std::string& text)
+	{
+		unsigned int a, b, c, d, port = 0;
+		int consumed = 0;
+		if (std::sscanf(text.c_str(), "%u.%u.%u.%u%n", &a, &b, &c, &d, &consumed) != 4)
+			return false;
+		if (a > 255 || b > 255 || c > 255 || d > 255)
+			return false;
+
+		// Optional port
+		const char* rest = text.c_str() + consumed;
+		if (*rest == ':')
+		{
+			int port_consumed = 0;
+			if (std::sscanf(rest + 1, "%u%n", &port, &port_consumed) != 1 || rest[1 + port_consumed] != '\0' || port > 65535)
+				return false;
+		}
+		else if (*rest != '\0')
+		{
+			return false;
+		}
+
+		endpoint.mAddress = (a << 24) | (b << 16) | (c << 8) | d;
+		endpoint.mPort = static_cast<uint16_t>(port);
+		return true;
+	}
+
+}
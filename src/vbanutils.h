@@ -7,6 +7,7 @@
 #include <utility/errorstate.h>
 #include <utility/dllexport.h>
 #include "vban/vban.h"
+#include "vbanstreamkey.h"
 
 namespace nap
 {
@@ -28,6 +29,20 @@ namespace nap
 		 * @return true on success
 		 */
 		bool NAPAPI getSampleRateFromVBANSampleRateFormat(int& sampleRate, uint8_t srFormat);
+
+		/**
+		 * @return the highest sample rate VBAN supports
+		 */
+		int NAPAPI getVBANMaxSampleRate();
+
+		/**
+		 * Parses an endpoint from a string formatted as "address" or "address:port", for example "192.168.1.10:6980".
+		 * When the port is omitted it is set to 0, which matches any port when the endpoint is used as filter.
+		 * @param endpoint the parsed endpoint
+		 * @param text the IPv4 address with optional port
+		 * @return true on success
+		 */
+		bool NAPAPI getVBANEndpointFromString(VBANEndpoint& endpoint, const std::string& text);
 	}
 }
 
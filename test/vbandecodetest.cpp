@@ -0,0 +1,126 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// Verifies that every conversion kernel the CPU supports is bit exact with the scalar reference,
+// for all lengths up to a few vector widths so every tail length is covered, at every source alignment.
+
+#include <vbandecode.h>
+
+// Std includes
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace nap;
+
+// Samples per length, covers the tails of 4, 8 and 16 wide kernels several times
+static constexpr int sMaxSampleCount = 70;
+
+// Marks destination samples the kernels must not write
+static constexpr uint32_t sCanary = 0x7fc0dead;
+
+
+// Fills the source with random bytes and the extreme values of the sample size at the start
+static void fillSource(std::vector<uint8_t>& source, int sampleSize, std::mt19937& random)
+{
+	for (auto& byte : source)
+		byte = static_cast<uint8_t>(random());
+
+	// Largest positive, most negative, zero and minus one
+	const uint8_t extremes[4][4] = { { 0xff, 0xff, 0xff, 0x7f }, { 0x00, 0x00, 0x00, 0x80 }, { 0x00, 0x00, 0x00, 0x00 }, { 0xff, 0xff, 0xff, 0xff } };
+	for (auto i = 0; i < 4 && (i + 1) * sampleSize <= static_cast<int>(source.size()); ++i)
+		std::memcpy(source.data() + i * sampleSize, extremes[i] + 4 - sampleSize, sampleSize);
+}
+
+
+// Compares a kernel with its reference, returns the number of mismatching lengths
+static int verifyKernel(utility::VBANDecodeKernels::ConvertFunction kernel, utility::VBANDecodeKernels::ConvertFunction reference, int sampleSize, const char* name, const char* instructionSet)
+{
+	std::mt19937 random(sampleSize);
+	int failures = 0;
+	for (auto offset = 0; offset < 4; ++offset)
+	{
+		for (auto count = 0; count <= sMaxSampleCount; ++count)
+		{
+			// Exactly sized source, so reading past the samples is caught by address sanitizer
+			std::vector<uint8_t> storage(offset + count * sampleSize);
+			std::vector<uint8_t> source(count * sampleSize);
+			fillSource(source, sampleSize, random);
+			if (!source.empty())
+				std::memcpy(storage.data() + offset, source.data(), source.size());
+
+			// One canary sample after the destination
+			std::vector<uint32_t> expected(count + 1, sCanary);
+			std::vector<uint32_t> result(count + 1, sCanary);
+			reference(storage.data() + offset, count, reinterpret_cast<float*>(expected.data()));
+			kernel(storage.data() + offset, count, reinterpret_cast<float*>(result.data()));
+
+			if (result != expected)
+			{
+				std::printf("%s %s: mismatch for %i samples at offset %i\n", instructionSet, name, count, offset);
+				++failures;
+			}
+		}
+	}
+	return failures;
+}
+
+
+// Compares deinterleaving with a plain copy of every sample, returns the number of mismatching layouts
+static int verifyDeinterleave()
+{
+	std::mt19937 random(0);
+	int failures = 0;
+	for (auto frame_size = 1; frame_size <= 4; ++frame_size)
+	{
+		for (auto channel_count = 1; channel_count <= frame_size; ++channel_count)
+		{
+			for (auto frame_count = 0; frame_count <= sMaxSampleCount; ++frame_count)
+			{
+				std::vector<float> source(std::max(frame_count * frame_size, 1));
+				for (auto& sample : source)
+					sample = static_cast<float>(random()) / static_cast<float>(random.max());
+
+				std::vector<std::vector<float>> planes(channel_count, std::vector<float>(frame_count + 1, -1.f));
+				std::vector<float*> channels;
+				for (auto& plane : planes)
+					channels.emplace_back(plane.data());
+				utility::deinterleaveVBANFrames(source.data(), frame_count, channel_count, frame_size, channels.data());
+
+				bool equal = true;
+				for (auto channel = 0; channel < channel_count; ++channel)
+				{
+					for (auto frame = 0; frame < frame_count; ++frame)
+						equal &= planes[channel][frame] == source[frame * frame_size + channel];
+					equal &= planes[channel][frame_count] == -1.f;
+				}
+				if (!equal)
+				{
+					std::printf("deinterleave: mismatch for %i of %i channels, %i frames\n", channel_count, frame_size, frame_count);
+					++failures;
+				}
+			}
+		}
+	}
+	return failures;
+}
+
+
+int main()
+{
+	int failures = 0;
+	for (const auto& kernels : utility::getSupportedVBANDecodeKernels())
+	{
+		failures += verifyKernel(kernels.mConvertInt16, &utility::convertVBANInt16Reference, 2, "int16", kernels.mInstructionSet);
+		failures += verifyKernel(kernels.mConvertInt24, &utility::convertVBANInt24Reference, 3, "int24", kernels.mInstructionSet);
+		failures += verifyKernel(kernels.mConvertInt32, &utility::convertVBANInt32Reference, 4, "int32", kernels.mInstructionSet);
+		std::printf("%s kernels verified\n", kernels.mInstructionSet);
+	}
+	failures += verifyDeinterleave();
+
+	std::printf("%s, selected %s\n", failures == 0 ? "Passed" : "Failed", utility::getVBANDecodeInstructionSet());
+	return failures == 0 ? 0 : 1;
+}
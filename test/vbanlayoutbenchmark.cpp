@@ -0,0 +1,124 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// Compares the planar and interleaved buffer layouts of VBANCircularBuffer for 2, 16, 64 and 256 channels.
+// Packets of the largest size VBAN allows for the channel count are written as they would arrive,
+// and read one audio block at a time as the audio thread does. Prints the time spent writing and reading per second of audio.
+// Run by hand on an idle machine.
+
+#include <vbancircularbuffer.h>
+#include <vbandecode.h>
+#include <vbanutils.h>
+
+// Nap includes
+#include <audio/core/audionodemanager.h>
+#include <audio/utility/safeptr.h>
+
+// Std includes
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace nap;
+
+static constexpr int sSampleRate = 48000;
+static constexpr int sBufferSize = 256;
+static constexpr int sSeconds = 20;				// Seconds of audio written and read per measurement
+static const char* sStreamName = "benchmark";
+
+
+// Fills a 16 bit PCM packet with random samples, only the packet counter changes afterwards
+static void makePacket(VBANPacket& packet, int channelCount, int frameCount)
+{
+	std::mt19937 random(channelCount);
+	for (size_t i = 0; i < packet.capacity(); ++i)
+		packet.data()[i] = static_cast<uint8_t>(random());
+
+	auto& header = *reinterpret_cast<VBanHeader*>(packet.data());
+	std::memcpy(&header.vban, "VBAN", 4);
+	uint8_t sample_rate_format = 0;
+	utility::getVBANSampleRateFormatFromSampleRate(sample_rate_format, sSampleRate);
+	header.format_SR = sample_rate_format | VBAN_PROTOCOL_AUDIO;
+	header.format_nbs = frameCount - 1;
+	header.format_nbc = channelCount - 1;
+	header.format_bit = VBAN_BITFMT_16_INT;
+	std::memset(header.streamname, 0, VBAN_STREAM_NAME_SIZE);
+	std::strncpy(header.streamname, sStreamName, VBAN_STREAM_NAME_SIZE);
+	header.nuFrame = 0;
+	packet.setSize(VBAN_HEADER_SIZE + frameCount * channelCount * 2);
+}
+
+
+// Writes and reads sSeconds of audio of a single stream, prints the milliseconds spent per second of audio
+static void measure(audio::NodeManager& nodeManager, EVBANBufferLayout layout, int channelCount)
+{
+	auto buffer = nodeManager.makeSafe<VBANCircularBuffer>(nodeManager, 16384, 1, layout);
+	nodeManager.registerRootProcess(buffer.get());
+	buffer->addStream(sStreamName, channelCount);
+	const auto handle = buffer->getStreamHandle(sStreamName);
+
+	// The largest packet VBAN allows for the channel count
+	const int frame_count = std::min(utility::VBAN_MAX_PACKET_FRAME_COUNT, (VBAN_PROTOCOL_MAX_SIZE - VBAN_HEADER_SIZE) / (channelCount * 2));
+	VBANPacket packet;
+	makePacket(packet, channelCount, frame_count);
+	auto& header = *reinterpret_cast<VBanHeader*>(packet.data());
+
+	// Output buffers of the audio thread, and the reader state of a VBANCircularBufferReader
+	std::vector<audio::SampleBuffer> outputs(channelCount, audio::SampleBuffer(sBufferSize, 0.f));
+	std::vector<audio::SampleBuffer*> output_pointers;
+	for (auto& output : outputs)
+		output_pointers.emplace_back(&output);
+	VBANResampler resampler(EVBANResamplerQuality::High, sSampleRate);
+	resampler.reserve(channelCount, sBufferSize, VBANCircularBuffer::getMaxReadStep(sSampleRate));
+	VBANConcealer concealer;
+	concealer.setChannelCount(channelCount);
+
+	// Packets are written a few blocks ahead of the read position, as they arrive with the default latency
+	std::chrono::steady_clock::duration write_time = { };
+	std::chrono::steady_clock::duration read_time = { };
+	float** no_channels = nullptr;
+	uint32_t packet_counter = 0;
+	const int block_count = sSeconds * sSampleRate / sBufferSize;
+	for (auto block = 0; block < block_count; ++block)
+	{
+		const auto write_start = std::chrono::steady_clock::now();
+		while (static_cast<int64_t>(packet_counter) * frame_count < static_cast<int64_t>(block + 3) * sBufferSize)
+		{
+			header.nuFrame = packet_counter++;
+			buffer->write(packet);
+		}
+		write_time += std::chrono::steady_clock::now() - write_start;
+
+		nodeManager.process(no_channels, no_channels, sBufferSize);
+
+		const auto read_start = std::chrono::steady_clock::now();
+		buffer->read(handle, output_pointers, resampler, concealer);
+		read_time += std::chrono::steady_clock::now() - read_start;
+	}
+
+	nodeManager.unregisterRootProcess(buffer.get());
+
+	const auto to_milliseconds = [](std::chrono::steady_clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count() / sSeconds; };
+	std::printf("%-12s %4i channels %4i frames per packet %9.3f ms write %9.3f ms read per second of audio\n",
+		layout == EVBANBufferLayout::Planar ? "Planar" : "Interleaved", channelCount, frame_count, to_milliseconds(write_time), to_milliseconds(read_time));
+}
+
+
+int main()
+{
+	audio::DeletionQueue deletionQueue;
+	audio::NodeManager nodeManager(deletionQueue);
+	nodeManager.setInternalBufferSize(sBufferSize);
+	nodeManager.setSampleRate(sSampleRate);
+
+	for (auto channel_count : { 2, 16, 64, 256 })
+	{
+		measure(nodeManager, EVBANBufferLayout::Planar, channel_count);
+		measure(nodeManager, EVBANBufferLayout::Interleaved, channel_count);
+	}
+	return 0;
+}
@@ -0,0 +1,177 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// Measures how many packets per second a VBANUDPServer receives over loopback, and how many per second of CPU time of its receiving thread.
+// A sender thread sends 64 channel packets as fast as it can, the listener only counts them so the receive path itself is measured.
+// Every receive engine is measured in turn: receiving a single datagram per system call, batched with recvmmsg and through io_uring.
+// Run by hand on an idle machine, optionally with the port and the core to pin the receiving thread to as arguments.
+
+#include <vbanudpserver.h>
+#include <vbanutils.h>
+
+// Nap includes
+#include <utility/errorstate.h>
+
+// Asio includes
+#include <asio/ip/udp.hpp>
+#include <asio/io_service.hpp>
+
+// Std includes
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+	#include <pthread.h>
+	#include <time.h>
+#endif
+
+using namespace nap;
+
+static constexpr int sChannelCount = 64;
+static constexpr int sFrameCount = 11;							// Frames of 64 channels of 16 bit that fit in a packet
+static constexpr auto sDuration = std::chrono::seconds(3);
+
+
+// Receive mode of the server to measure
+struct Configuration
+{
+	const char* mName = "";
+	bool mBatchReceive = false;
+	EVBANReceiveEngine mEngine = EVBANReceiveEngine::Socket;
+};
+
+
+// Fills a 16 bit PCM packet with the given packet counter
+static int makePacket(std::vector<uint8_t>& packet, uint32_t packetCounter)
+{
+	const int size = VBAN_HEADER_SIZE + sFrameCount * sChannelCount * 2;
+	packet.assign(size, 0);
+	auto& header = *reinterpret_cast<VBanHeader*>(packet.data());
+	std::memcpy(&header.vban, "VBAN", 4);
+	uint8_t sample_rate_format = 0;
+	utility::getVBANSampleRateFormatFromSampleRate(sample_rate_format, 48000);
+	header.format_SR = sample_rate_format | VBAN_PROTOCOL_AUDIO;
+	header.format_nbs = sFrameCount - 1;
+	header.format_nbc = sChannelCount - 1;
+	header.format_bit = VBAN_BITFMT_16_INT;
+	std::strncpy(header.streamname, "benchmark", VBAN_STREAM_NAME_SIZE);
+	header.nuFrame = packetCounter;
+	return size;
+}
+
+
+// Receives for sDuration with the given configuration and prints the throughput
+static bool measure(const Configuration& configuration, int port, int core)
+{
+	VBANUDPServer server;
+	server.mID = configuration.mName;
+	server.mPort = port;
+	server.mIPAddress = "127.0.0.1";
+	server.mReceiveBufferSize = 8000000;
+	server.mBatchReceive = configuration.mBatchReceive;
+	server.mReceiveEngine = configuration.mEngine;
+	if (core >= 0)
+		server.mCPUCores = { core };
+
+	// Counts the packets, and remembers the CPU clock of the receiving thread
+	std::atomic<int64> packet_count = { 0 };
+#ifdef __linux__
+	std::atomic<bool> has_clock = { false };
+	clockid_t receive_clock;
+#endif
+	Slot<const VBANPacket&> slot([&](const VBANPacket&)
+	{
+#ifdef __linux__
+		if (!has_clock.load(std::memory_order_relaxed))
+		{
+			pthread_getcpuclockid(pthread_self(), &receive_clock);
+			has_clock.store(true);
+		}
+#endif
+		packet_count.fetch_add(1, std::memory_order_relaxed);
+	});
+	server.registerListenerSlot(slot);
+
+	utility::ErrorState error_state;
+	if (!server.start(error_state))
+	{
+		std::printf("%s: %s\n", configuration.mName, error_state.toString().c_str());
+		return false;
+	}
+
+	// Sends until the measurement is done
+	std::atomic<bool> sending = { true };
+	std::thread sender([&]()
+	{
+		asio::io_context context;
+		asio::ip::udp::socket socket(context, asio::ip::udp::v4());
+		const asio::ip::udp::endpoint destination(asio::ip::make_address("127.0.0.1"), static_cast<unsigned short>(port));
+		std::vector<uint8_t> packet;
+		asio::error_code error_code;
+		for (uint32_t counter = 0; sending.load(std::memory_order_relaxed); ++counter)
+		{
+			const int size = makePacket(packet, counter);
+			socket.send_to(asio::buffer(packet.data(), size), destination, 0, error_code);
+		}
+	});
+
+	// Skip the first packets, the threads are still warming up
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	const auto start_count = packet_count.load();
+	const auto start_time = std::chrono::steady_clock::now();
+#ifdef __linux__
+	timespec start_cpu = { 0, 0 };
+	if (has_clock.load())
+		clock_gettime(receive_clock, &start_cpu);
+#endif
+
+	std::this_thread::sleep_for(sDuration);
+
+	const auto count = packet_count.load() - start_count;
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	double cpu_seconds = 0.0;
+#ifdef __linux__
+	timespec end_cpu = { 0, 0 };
+	if (has_clock.load())
+	{
+		clock_gettime(receive_clock, &end_cpu);
+		cpu_seconds = static_cast<double>(end_cpu.tv_sec - start_cpu.tv_sec) + static_cast<double>(end_cpu.tv_nsec - start_cpu.tv_nsec) * 1e-9;
+	}
+#endif
+
+	sending.store(false);
+	sender.join();
+	server.stop();
+	server.removeListenerSlot(slot);
+
+	if (cpu_seconds > 0.0)
+		std::printf("%-16s %12.0f packets/s %12.0f packets/s per core %6.1f%% CPU\n", configuration.mName, count / seconds, count / cpu_seconds, 100.0 * cpu_seconds / seconds);
+	else
+		std::printf("%-16s %12.0f packets/s\n", configuration.mName, count / seconds);
+	return true;
+}
+
+
+int main(int argc, char** argv)
+{
+	const int port = argc > 1 ? std::atoi(argv[1]) : 13300;
+	const int core = argc > 2 ? std::atoi(argv[2]) : -1;
+
+	const std::vector<Configuration> configurations =
+	{
+		{ "Socket", false, EVBANReceiveEngine::Socket },
+		{ "Socket batch", true, EVBANReceiveEngine::Socket },
+		{ "IOUring", false, EVBANReceiveEngine::IOUring },		// Measures the socket receive again when the server logs that it falls back
+	};
+
+	bool success = true;
+	for (const auto& configuration : configurations)
+		success &= measure(configuration, port, core);
+	return success ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// Verifies a stream that is received over two redundant paths: the packet counters when the sender restarts,
+// and that the stream is read back without gaps when each path loses packets the other delivers.
+
+#include <vbancircularbuffer.h>
+#include <vbanutils.h>
+
+// Nap includes
+#include <audio/core/audionodemanager.h>
+#include <audio/utility/safeptr.h>
+
+// Std includes
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace nap;
+
+static constexpr int sFrameCount = 256;
+static constexpr int sChannelCount = 2;
+static constexpr int sSampleRate = 48000;
+static constexpr uint32_t sWriteAhead = 2;			// Packets written ahead of the block that is read, the default latency in blocks
+static const char* sStreamName = "redundant";
+
+
+// Sample of a channel in a frame of a packet, distinct within a ring and never 0, so frames output as silence stand out
+static int16_t getSample(uint32_t packetCounter, int frame, int channel)
+{
+	return static_cast<int16_t>(((packetCounter * sFrameCount + frame) * sChannelCount + channel) % 32000 + 1);
+}
+
+
+// Fills a 16 bit PCM packet of the test stream with the given packet counter
+static void makePacket(VBANPacket& packet, uint32_t packetCounter)
+{
+	std::memset(packet.data(), 0, packet.capacity());
+	auto& header = *reinterpret_cast<VBanHeader*>(packet.data());
+	std::memcpy(&header.vban, "VBAN", 4);
+	uint8_t sample_rate_format = 0;
+	utility::getVBANSampleRateFormatFromSampleRate(sample_rate_format, sSampleRate);
+	header.format_SR = sample_rate_format | VBAN_PROTOCOL_AUDIO;
+	header.format_nbs = sFrameCount - 1;
+	header.format_nbc = sChannelCount - 1;
+	header.format_bit = VBAN_BITFMT_16_INT;
+	std::strncpy(header.streamname, sStreamName, VBAN_STREAM_NAME_SIZE);
+	header.nuFrame = packetCounter;
+	packet.setSize(VBAN_HEADER_SIZE + sFrameCount * sChannelCount * 2);
+
+	uint8_t* samples = packet.data() + VBAN_HEADER_SIZE;
+	for (auto frame = 0; frame < sFrameCount; ++frame)
+	{
+		for (auto channel = 0; channel < sChannelCount; ++channel)
+		{
+			const auto sample = static_cast<uint16_t>(getSample(packetCounter, frame, channel));
+			*samples++ = static_cast<uint8_t>(sample & 0xff);
+			*samples++ = static_cast<uint8_t>(sample >> 8);
+		}
+	}
+}
+
+
+// Writes the packets with counters first to last over the given path
+static void writePackets(VBANCircularBuffer& buffer, int path, uint32_t first, uint32_t last)
+{
+	VBANPacket packet;
+	for (auto counter = first; counter <= last; ++counter)
+	{
+		makePacket(packet, counter);
+		buffer.write(packet, path);
+	}
+}
+
+
+// Compares the lost, stale and duplicate counters with the expected ones, returns 1 on a mismatch
+static int verifyCounters(const VBANReceiveStatistics::Snapshot& snapshot, int64_t lost, int64_t stale, int64_t duplicates, const char* test, const char* counters)
+{
+	if (snapshot.mLostCount == lost && snapshot.mStaleCount == stale && snapshot.mDuplicateCount == duplicates)
+		return 0;
+	std::printf("%s: %s counted %lli lost, %lli stale and %lli duplicates, expected %lli, %lli and %lli\n", test, counters,
+		static_cast<long long>(snapshot.mLostCount), static_cast<long long>(snapshot.mStaleCount), static_cast<long long>(snapshot.mDuplicateCount),
+		static_cast<long long>(lost), static_cast<long long>(stale), static_cast<long long>(duplicates));
+	return 1;
+}
+
+
+// Reads a stream one audio block at a time as the audio thread does. A block is as long as a packet,
+// the first block starts at packet 0 when packets 0 to sWriteAhead are written before it is read.
+class StreamReader
+{
+public:
+	StreamReader(audio::NodeManager& nodeManager, VBANCircularBuffer& buffer) : mNodeManager(nodeManager), mBuffer(buffer),
+		mHandle(buffer.getStreamHandle(sStreamName)), mOutputs(sChannelCount, audio::SampleBuffer(sFrameCount, 0.f)),
+		mResampler(EVBANResamplerQuality::High, sSampleRate)
+	{
+		for (auto& output : mOutputs)
+			mOutputPointers.emplace_back(&output);
+		mResampler.reserve(sChannelCount, sFrameCount, VBANCircularBuffer::getMaxReadStep(sSampleRate));
+		mConcealer.setChannelCount(sChannelCount);
+	}
+
+	// Reads the next block, returns 1 when it doesn't hold the samples of the given packet
+	int verifyBlock(uint32_t packetCounter, const char* test)
+	{
+		float** no_channels = nullptr;
+		mNodeManager.process(no_channels, no_channels, sFrameCount);
+		mBuffer.read(mHandle, mOutputPointers, mResampler, mConcealer);
+
+		for (auto frame = 0; frame < sFrameCount; ++frame)
+		{
+			for (auto channel = 0; channel < sChannelCount; ++channel)
+			{
+				const float expected = getSample(packetCounter, frame, channel) / 32767.f;
+				const float sample = mOutputs[channel][frame];
+				if (std::abs(sample - expected) > 1e-6f)
+				{
+					std::printf("%s: packet %u reads %f at frame %i of channel %i, expected %f\n", test, packetCounter, sample, frame, channel, expected);
+					return 1;
+				}
+			}
+		}
+		return 0;
+	}
+
+private:
+	audio::NodeManager& mNodeManager;
+	VBANCircularBuffer& mBuffer;
+	VBANCircularBuffer::StreamHandle mHandle;
+	std::vector<audio::SampleBuffer> mOutputs;
+	std::vector<audio::SampleBuffer*> mOutputPointers;
+	VBANResampler mResampler;
+	VBANConcealer mConcealer;
+};
+
+
+// The sender restarts, path 0 delivers the new sequence while path 1 still delivers packets from before the restart
+static int verifyRestartWhilePathLags(audio::NodeManager& nodeManager)
+{
+	const char* test = "restart while a path lags";
+	VBANCircularBuffer buffer(nodeManager, 8192);
+	buffer.addStream(sStreamName, sChannelCount);
+	const auto key = VBANCircularBuffer::getStreamKey(sStreamName);
+
+	for (uint32_t counter = 0; counter < 100; ++counter)
+	{
+		writePackets(buffer, 0, counter, counter);
+		writePackets(buffer, 1, counter, counter);
+	}
+	writePackets(buffer, 0, 0, 19);
+	writePackets(buffer, 1, 100, 104);
+	writePackets(buffer, 1, 0, 19);
+
+	// The lagging packets are dropped before they are counted over all paths, the copies of path 1 are duplicates
+	int failures = 0;
+	VBANReceiveStatistics::Snapshot snapshot;
+	buffer.getReceiveStatistics(key, snapshot);
+	failures += verifyCounters(snapshot, 0, 0, 120, test, "merged statistics");
+	buffer.getPathStatistics(key, 0, snapshot);
+	failures += verifyCounters(snapshot, 0, 0, 0, test, "path 0");
+	buffer.getPathStatistics(key, 1, snapshot);
+	failures += verifyCounters(snapshot, 0, 0, 0, test, "path 1");
+	return failures;
+}
+
+
+// The sender restarts before the stream travelled a ring, the packets of the new sequence are no duplicates of the old
+static int verifyEarlyRestart(audio::NodeManager& nodeManager)
+{
+	const char* test = "restart within a ring";
+	VBANCircularBuffer buffer(nodeManager, 8192);
+	buffer.addStream(sStreamName, sChannelCount);
+	const auto key = VBANCircularBuffer::getStreamKey(sStreamName);
+
+	writePackets(buffer, 0, 0, 9);
+	writePackets(buffer, 0, 0, 10);
+
+	VBANReceiveStatistics::Snapshot snapshot;
+	buffer.getReceiveStatistics(key, snapshot);
+	return verifyCounters(snapshot, 0, 0, 0, test, "merged statistics");
+}
+
+
+// Each path loses every fourth packet, path 0 the packets after a multiple of 4 and path 1 the packets before one.
+// Every packet is read back from the path that delivered it, and each path counts the packets it lost.
+static int verifyDisjointLosses(audio::NodeManager& nodeManager)
+{
+	const char* test = "disjoint losses";
+	auto buffer = nodeManager.makeSafe<VBANCircularBuffer>(nodeManager, 8192);
+	nodeManager.registerRootProcess(buffer.get());
+	buffer->addStream(sStreamName, sChannelCount);
+	const auto key = VBANCircularBuffer::getStreamKey(sStreamName);
+	StreamReader reader(nodeManager, *buffer.get());
+
+	// The last packet arrives over both paths, so the losses before it are counted
+	const uint32_t last = 400;
+	auto is_lost = [](int path, uint32_t counter) { return counter % 4 == (path == 0 ? 1u : 3u); };
+	int64_t lost[2] = { 0, 0 };
+
+	int failures = 0;
+	uint32_t next = 0;
+	for (uint32_t block = 0; block + sWriteAhead <= last; ++block)
+	{
+		for (; next <= block + sWriteAhead; ++next)
+		{
+			for (auto path = 0; path < 2; ++path)
+			{
+				if (is_lost(path, next))
+					lost[path]++;
+				else
+					writePackets(*buffer.get(), path, next, next);
+			}
+		}
+		failures += reader.verifyBlock(block, test);
+	}
+	nodeManager.unregisterRootProcess(buffer.get());
+
+	// Packets that arrived over both paths are duplicates over all paths
+	VBANReceiveStatistics::Snapshot snapshot;
+	buffer->getReceiveStatistics(key, snapshot);
+	failures += verifyCounters(snapshot, 0, 0, last + 1 - lost[0] - lost[1], test, "merged statistics");
+	buffer->getPathStatistics(key, 0, snapshot);
+	failures += verifyCounters(snapshot, lost[0], 0, 0, test, "path 0");
+	buffer->getPathStatistics(key, 1, snapshot);
+	failures += verifyCounters(snapshot, lost[1], 0, 0, test, "path 1");
+	return failures;
+}
+
+
+// Two threads write the paths at the same time, as the shards of a redundant server do, and lose disjoint packets.
+// A packet that arrives while the other path writes the stream waits for it, so the stream is read back without gaps.
+static int verifyConcurrentPaths(audio::NodeManager& nodeManager)
+{
+	const char* test = "concurrent paths";
+	auto buffer = nodeManager.makeSafe<VBANCircularBuffer>(nodeManager, 8192);
+	nodeManager.registerRootProcess(buffer.get());
+	buffer->addStream(sStreamName, sChannelCount);
+	const auto key = VBANCircularBuffer::getStreamKey(sStreamName);
+	StreamReader reader(nodeManager, *buffer.get());
+
+	const uint32_t last = 4000;
+	auto is_lost = [](int path, uint32_t counter) { return counter % 3 == (path == 0 ? 1u : 2u); };
+
+	// Packets are released to both writers one at a time, so both copies of a packet are written at nearly the same moment
+	std::atomic<uint32_t> released = { sWriteAhead };
+	std::atomic<uint32_t> written[2] = { { 0 }, { 0 } };
+	int64_t lost[2] = { 0, 0 };
+	auto write_path = [&](int path)
+	{
+		for (uint32_t counter = 0; counter <= last; ++counter)
+		{
+			while (counter > released.load(std::memory_order_acquire))
+				std::this_thread::yield();
+			if (is_lost(path, counter))
+				lost[path]++;
+			else
+				writePackets(*buffer.get(), path, counter, counter);
+			written[path].store(counter + 1, std::memory_order_release);
+		}
+	};
+	std::thread path_0(write_path, 0);
+	std::thread path_1(write_path, 1);
+
+	int failures = 0;
+	for (uint32_t block = 0; block + sWriteAhead <= last; ++block)
+	{
+		released.store(block + sWriteAhead, std::memory_order_release);
+		while (written[0].load(std::memory_order_acquire) <= block + sWriteAhead || written[1].load(std::memory_order_acquire) <= block + sWriteAhead)
+			std::this_thread::yield();
+		failures += reader.verifyBlock(block, test);
+	}
+	path_0.join();
+	path_1.join();
+	nodeManager.unregisterRootProcess(buffer.get());
+	std::printf("%s: %lli packets waited for the other path\n", test, static_cast<long long>(buffer->getWriteContentionCount()));
+
+	// Either path may write a packet first, over all paths every packet is counted once and its copy as a duplicate
+	VBANReceiveStatistics::Snapshot snapshot;
+	buffer->getReceiveStatistics(key, snapshot);
+	failures += verifyCounters(snapshot, 0, 0, last + 1 - lost[0] - lost[1], test, "merged statistics");
+	buffer->getPathStatistics(key, 0, snapshot);
+	failures += verifyCounters(snapshot, lost[0], 0, 0, test, "path 0");
+	buffer->getPathStatistics(key, 1, snapshot);
+	failures += verifyCounters(snapshot, lost[1], 0, 0, test, "path 1");
+	return failures;
+}
+
+
+int main()
+{
+	audio::DeletionQueue deletionQueue;
+	audio::NodeManager nodeManager(deletionQueue);
+	nodeManager.setInternalBufferSize(256);
+	nodeManager.setSampleRate(sSampleRate);
+
+	int failures = 0;
+	failures += verifyRestartWhilePathLags(nodeManager);
+	failures += verifyEarlyRestart(nodeManager);
+	failures += verifyDisjointLosses(nodeManager);
+	failures += verifyConcurrentPaths(nodeManager);
+
+	std::printf("%s\n", failures == 0 ? "Passed" : "Failed");
+	return failures == 0 ? 0 : 1;
+}
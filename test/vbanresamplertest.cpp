@@ -0,0 +1,74 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// Verifies the conversion error every VBANResampler quality documents, for a 1 kHz sine converted from 44.1 kHz to 48 kHz.
+// The error is the power of the difference with the exact sine at the output times, relative to the power of the sine.
+
+#include <vbanresampler.h>
+
+// Std includes
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace nap;
+
+static constexpr double sPi = 3.14159265358979323846;
+static constexpr int sInputSampleRate = 44100;
+static constexpr int sOutputSampleRate = 48000;
+static constexpr double sFrequency = 1000.0;
+static constexpr int sFrameCount = 4096;
+
+
+// Returns the conversion error in dB
+static double measureError(EVBANResamplerQuality quality)
+{
+	VBANResampler resampler(quality, sOutputSampleRate);
+	const double step = static_cast<double>(sInputSampleRate) / sOutputSampleRate;
+	resampler.setRatio(step);
+	resampler.reserve(1, sFrameCount, step);
+
+	// Start in between two input frames, so every output frame is interpolated
+	const double phase = 0.37;
+	const int input_frame_count = resampler.getInputFrameCount(phase, step, sFrameCount);
+	float* const* input = resampler.getInputBuffers(1, input_frame_count);
+	const int history = resampler.getHistoryFrameCount();
+	for (auto i = 0; i < input_frame_count; ++i)
+		input[0][i] = static_cast<float>(0.5 * std::sin(2.0 * sPi * sFrequency * (i - history) / sInputSampleRate));
+
+	std::vector<float> output(sFrameCount);
+	float* output_channel = output.data();
+	resampler.process(input, 1, phase, step, sFrameCount, &output_channel);
+
+	double error_power = 0.0;
+	double signal_power = 0.0;
+	for (auto i = 0; i < sFrameCount; ++i)
+	{
+		const double expected = 0.5 * std::sin(2.0 * sPi * sFrequency * (phase + i * step) / sInputSampleRate);
+		error_power += (output[i] - expected) * (output[i] - expected);
+		signal_power += expected * expected;
+	}
+	return 10.0 * std::log10(error_power / signal_power);
+}
+
+
+// Compares the error of a quality with the documented error, with 1 dB of tolerance. Returns 1 when it exceeds it
+static int verifyQuality(EVBANResamplerQuality quality, double documentedError, const char* name)
+{
+	const double error = measureError(quality);
+	std::printf("%s: %.1f dB, documented %.0f dB\n", name, error, documentedError);
+	return error <= documentedError + 1.0 ? 0 : 1;
+}
+
+
+int main()
+{
+	int failures = 0;
+	failures += verifyQuality(EVBANResamplerQuality::Low, -61.0, "Low");
+	failures += verifyQuality(EVBANResamplerQuality::Medium, -72.0, "Medium");
+	failures += verifyQuality(EVBANResamplerQuality::High, -85.0, "High");
+
+	std::printf("%s\n", failures == 0 ? "Passed" : "Failed");
+	return failures == 0 ? 0 : 1;
+}